@@ -41,6 +41,7 @@
 #include "backends/meta-idle-monitor-private.h"
 
 #include "backends/meta-monitor-manager-dummy.h"
+#include "backends/meta-monitor-config.h"
 
 static MetaBackend *_backend;
 
@@ -691,6 +692,11 @@ meta_clutter_init (void)
   ClutterSettings *clutter_settings;
   GSource *source;
 
+  /* The monitor manager needs the stored configurations right after
+   * clutter is up; read them while it initializes.
+   */
+  meta_monitor_config_preload ();
+
   meta_create_backend ();
 
   if (clutter_init (NULL, NULL) != CLUTTER_INIT_SUCCESS)
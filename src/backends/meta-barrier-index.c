@@ -0,0 +1,130 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "backends/meta-barrier-index.h"
+
+typedef struct
+{
+  float    position;
+  gpointer barrier;
+} MetaBarrierIndexEntry;
+
+struct _MetaBarrierIndex
+{
+  /* MetaBarrierIndexEntry, sorted by position */
+  GArray *entries;
+};
+
+MetaBarrierIndex *
+meta_barrier_index_new (void)
+{
+  MetaBarrierIndex *index;
+
+  index = g_new0 (MetaBarrierIndex, 1);
+  index->entries = g_array_new (FALSE, FALSE, sizeof (MetaBarrierIndexEntry));
+
+  return index;
+}
+
+void
+meta_barrier_index_free (MetaBarrierIndex *index)
+{
+  g_array_free (index->entries, TRUE);
+  g_free (index);
+}
+
+/* Returns the index of the first entry positioned at or after @position */
+static guint
+find_first_entry_at (MetaBarrierIndex *index,
+                     float             position)
+{
+  guint low = 0;
+  guint high = index->entries->len;
+
+  while (low < high)
+    {
+      guint mid = low + (high - low) / 2;
+
+      if (g_array_index (index->entries, MetaBarrierIndexEntry, mid).position < position)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+  return low;
+}
+
+void
+meta_barrier_index_add (MetaBarrierIndex *index,
+                        gpointer          barrier,
+                        float             position)
+{
+  MetaBarrierIndexEntry entry = {
+    .position = position,
+    .barrier = barrier,
+  };
+
+  g_array_insert_val (index->entries,
+                      find_first_entry_at (index, position),
+                      entry);
+}
+
+void
+meta_barrier_index_remove (MetaBarrierIndex *index,
+                           gpointer          barrier)
+{
+  guint i;
+
+  for (i = 0; i < index->entries->len; i++)
+    {
+      if (g_array_index (index->entries, MetaBarrierIndexEntry, i).barrier == barrier)
+        {
+          g_array_remove_index (index->entries, i);
+          return;
+        }
+    }
+}
+
+/* Calls @func for every barrier positioned within [@min_position,
+ * @max_position], in order of position. @func must not change @index.
+ */
+void
+meta_barrier_index_foreach_in_range (MetaBarrierIndex     *index,
+                                     float                 min_position,
+                                     float                 max_position,
+                                     MetaBarrierIndexFunc  func,
+                                     gpointer              user_data)
+{
+  guint i;
+
+  for (i = find_first_entry_at (index, min_position);
+       i < index->entries->len;
+       i++)
+    {
+      MetaBarrierIndexEntry *entry =
+        &g_array_index (index->entries, MetaBarrierIndexEntry, i);
+
+      if (entry->position > max_position)
+        break;
+
+      func (entry->barrier, user_data);
+    }
+}
@@ -0,0 +1,49 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_BARRIER_INDEX_H
+#define META_BARRIER_INDEX_H
+
+#include <glib.h>
+
+/* Barriers are axis aligned, so a pointer motion can only cross the ones
+ * whose constant coordinate lies within the motion's extent along that
+ * axis. A MetaBarrierIndex keeps barriers of one orientation sorted by
+ * that coordinate, so those candidates are found by bisection rather
+ * than by looking at every barrier.
+ */
+typedef struct _MetaBarrierIndex MetaBarrierIndex;
+
+typedef void (* MetaBarrierIndexFunc) (gpointer barrier,
+                                       gpointer user_data);
+
+MetaBarrierIndex * meta_barrier_index_new              (void);
+void               meta_barrier_index_free             (MetaBarrierIndex     *index);
+void               meta_barrier_index_add              (MetaBarrierIndex     *index,
+                                                        gpointer              barrier,
+                                                        float                 position);
+void               meta_barrier_index_remove           (MetaBarrierIndex     *index,
+                                                        gpointer              barrier);
+void               meta_barrier_index_foreach_in_range (MetaBarrierIndex     *index,
+                                                        float                 min_position,
+                                                        float                 max_position,
+                                                        MetaBarrierIndexFunc  func,
+                                                        gpointer              user_data);
+
+#endif /* META_BARRIER_INDEX_H */
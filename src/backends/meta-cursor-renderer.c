@@ -182,6 +182,9 @@ meta_cursor_renderer_set_position (MetaCursorRenderer *renderer,
 
   g_assert (meta_is_wayland_compositor ());
 
+  if (priv->current_x == x && priv->current_y == y)
+    return;
+
   priv->current_x = x;
   priv->current_y = y;
 
@@ -43,6 +43,7 @@
 
 #include <meta/main.h>
 #include <meta/errors.h>
+#include <meta/util.h>
 
 /* These structures represent the intended/persistent configuration,
    as stored in the monitors.xml file.
@@ -235,30 +236,44 @@ config_equal_full (gconstpointer one,
   return ok;
 }
 
+static GHashTable *
+configs_new (void)
+{
+  return g_hash_table_new_full (config_hash, config_equal, NULL, (GDestroyNotify) config_unref);
+}
+
 static void
-meta_monitor_config_init (MetaMonitorConfig *self)
+get_config_files (GFile **user_file,
+                  GFile **system_file)
 {
   const char *filename;
   char *path;
   const char * const *system_dirs;
 
-  self->configs = g_hash_table_new_full (config_hash, config_equal, NULL, (GDestroyNotify) config_unref);
-
   filename = g_getenv ("MUTTER_MONITOR_FILENAME");
   if (filename == NULL)
     filename = "monitors.xml";
 
   path = g_build_filename (g_get_user_config_dir (), filename, NULL);
-  self->user_file = g_file_new_for_path (path);
+  *user_file = g_file_new_for_path (path);
   g_free (path);
 
-  for (system_dirs = g_get_system_config_dirs (); !self->system_file && *system_dirs; system_dirs++)
+  *system_file = NULL;
+  for (system_dirs = g_get_system_config_dirs (); !*system_file && *system_dirs; system_dirs++)
     {
       path = g_build_filename (*system_dirs, filename, NULL);
       if (g_file_test (path, G_FILE_TEST_EXISTS))
-        self->system_file = g_file_new_for_path (path);
+        *system_file = g_file_new_for_path (path);
       g_free (path);
     }
+}
+
+static void
+meta_monitor_config_init (MetaMonitorConfig *self)
+{
+  self->configs = configs_new ();
+
+  get_config_files (&self->user_file, &self->system_file);
 
   self->up_client = up_client_new ();
   self->lid_is_closed = up_client_get_lid_is_closed (self->up_client);
@@ -296,7 +311,7 @@ typedef enum {
 } ParserState;
 
 typedef struct {
-  MetaMonitorConfig *config;
+  GHashTable *configs;
   ParserState state;
   int unknown_count;
 
@@ -463,7 +478,7 @@ handle_end_element (GMarkupParseContext  *context,
             config->keys = (void*)g_array_free (parser->key_array, FALSE);
             config->outputs = (void*)g_array_free (parser->output_array, FALSE);
 
-            g_hash_table_replace (parser->config->configs, config, config);
+            g_hash_table_replace (parser->configs, config, config);
 
             parser->key_array = NULL;
             parser->output_array = NULL;
@@ -735,7 +750,7 @@ static const GMarkupParser config_parser = {
 };
 
 static gboolean
-load_config_file (MetaMonitorConfig *self, GFile *file)
+load_config_file (GHashTable *configs, GFile *file)
 {
   char *contents;
   gsize size;
@@ -749,7 +764,8 @@ load_config_file (MetaMonitorConfig *self, GFile *file)
      want atomic modeset as much as possible.
 
      This function is called only at early initialization anyway, before
-     we connect to X or create the wayland socket.
+     we connect to X or create the wayland socket, and usually from the
+     preload thread (see meta_monitor_config_preload()).
   */
 
   error = NULL;
@@ -762,7 +778,7 @@ load_config_file (MetaMonitorConfig *self, GFile *file)
     }
 
   memset (&parser, 0, sizeof (ConfigParser));
-  parser.config = self;
+  parser.configs = configs;
   parser.state = STATE_INITIAL;
 
   context = g_markup_parse_context_new (&config_parser,
@@ -791,13 +807,86 @@ load_config_file (MetaMonitorConfig *self, GFile *file)
   return ok;
 }
 
+static GHashTable *
+load_configs (GFile *user_file,
+              GFile *system_file)
+{
+  GHashTable *configs;
+
+  configs = configs_new ();
+
+  if (user_file && load_config_file (configs, user_file))
+    return configs;
+  if (system_file && load_config_file (configs, system_file))
+    return configs;
+
+  return configs;
+}
+
+typedef struct {
+  GFile *user_file;
+  GFile *system_file;
+} PreloadData;
+
+static GThread *preload_thread = NULL;
+
+static gpointer
+preload_thread_func (gpointer user_data)
+{
+  PreloadData *data = user_data;
+  GHashTable *configs;
+
+  configs = load_configs (data->user_file, data->system_file);
+
+  g_clear_object (&data->user_file);
+  g_clear_object (&data->system_file);
+  g_free (data);
+
+  return configs;
+}
+
+/* Starts reading and parsing the stored monitor configurations in a
+ * worker thread, so that it overlaps with the rest of the backend setup
+ * (clutter and GL initialization in particular). The first
+ * meta_monitor_config_new() waits for and takes over the result.
+ */
+void
+meta_monitor_config_preload (void)
+{
+  PreloadData *data;
+
+  g_return_if_fail (preload_thread == NULL);
+
+  data = g_new0 (PreloadData, 1);
+  get_config_files (&data->user_file, &data->system_file);
+
+  preload_thread = g_thread_new ("[mutter] monitor config",
+                                 preload_thread_func, data);
+}
+
 static void
 meta_monitor_config_load (MetaMonitorConfig *self)
 {
-  if (self->user_file && load_config_file (self, self->user_file))
-    return;
-  if (self->system_file && load_config_file (self, self->system_file))
-    return;
+  GHashTable *configs;
+
+  if (preload_thread)
+    {
+      gint64 start_time = g_get_monotonic_time ();
+
+      configs = g_thread_join (preload_thread);
+      preload_thread = NULL;
+
+      meta_topic (META_DEBUG_STARTUP,
+                  "Waited %" G_GINT64_FORMAT " us for preloaded monitor configurations\n",
+                  g_get_monotonic_time () - start_time);
+    }
+  else
+    {
+      configs = load_configs (self->user_file, self->system_file);
+    }
+
+  g_hash_table_destroy (self->configs);
+  self->configs = configs;
 }
 
 MetaMonitorConfig *
@@ -891,6 +980,7 @@ apply_configuration (MetaMonitorConfig  *self,
 {
   g_autoptr(GPtrArray) crtcs = NULL;
   g_autoptr(GPtrArray) outputs = NULL;
+  GError *error = NULL;
 
   crtcs = g_ptr_array_new_full (config->n_outputs, (GDestroyNotify)meta_crtc_info_free);
   outputs = g_ptr_array_new_full (config->n_outputs, (GDestroyNotify)meta_output_info_free);
@@ -898,9 +988,16 @@ apply_configuration (MetaMonitorConfig  *self,
   if (!meta_monitor_config_assign_crtcs (config, manager, crtcs, outputs))
     return FALSE;
 
-  meta_monitor_manager_apply_configuration (manager,
-                                            (MetaCRTCInfo**)crtcs->pdata, crtcs->len,
-                                            (MetaOutputInfo**)outputs->pdata, outputs->len);
+  if (!meta_monitor_manager_apply_configuration (manager,
+                                                 (MetaCRTCInfo**)crtcs->pdata, crtcs->len,
+                                                 (MetaOutputInfo**)outputs->pdata, outputs->len,
+                                                 &error))
+    {
+      meta_warning ("Failed to apply display configuration: %s\n",
+                    error->message);
+      g_error_free (error);
+      return FALSE;
+    }
 
   set_current (self, config);
 
@@ -1612,9 +1709,9 @@ turn_off_laptop_display (MetaMonitorConfig  *self,
     return;
 
   new = make_laptop_lid_config (self->current);
-  apply_configuration (self, new, manager);
+  if (apply_configuration (self, new, manager))
+    self->current_is_for_laptop_lid = TRUE;
   config_unref (new);
-  self->current_is_for_laptop_lid = TRUE;
 }
 
 static void
@@ -1774,6 +1871,18 @@ meta_monitor_config_save (MetaMonitorConfig *self)
 void
 meta_monitor_config_make_persistent (MetaMonitorConfig *self)
 {
+  MetaConfiguration *stored;
+
+  /* Going back to a layout that was stored before, e.g. when docking
+     again, leaves the file as it is; don't rewrite it.
+  */
+  stored = g_hash_table_lookup (self->configs, self->current);
+  if (stored && config_equal_full (stored, self->current))
+    {
+      meta_verbose ("Monitor configuration is already stored, not saving\n");
+      return;
+    }
+
   g_hash_table_replace (self->configs, self->current, config_ref (self->current));
   meta_monitor_config_save (self);
 }
@@ -1781,11 +1890,24 @@ meta_monitor_config_make_persistent (MetaMonitorConfig *self)
 /*
  * CRTC assignment
  */
+typedef struct
+{
+  MetaCRTC        *crtc;
+  MetaMonitorMode *mode;
+} CrtcCandidate;
+
 typedef struct
 {
   MetaConfiguration  *config;
   MetaMonitorManager *manager;
   GHashTable         *info;
+
+  /* For each output in the configuration, the matching MetaOutput and
+     the CRTC and mode combinations it can be driven with, in the order
+     they are tried.
+  */
+  MetaOutput        **outputs;
+  GArray            **candidates;
 } CrtcAssignment;
 
 static gboolean
@@ -1936,93 +2058,285 @@ find_output_by_key (MetaOutput    *outputs,
   return NULL;
 }
 
+static gboolean
+mode_matches_output_config (MetaMonitorMode  *mode,
+                            MetaOutputConfig *output_config)
+{
+  int width, height;
+
+  if (meta_monitor_transform_is_rotated (output_config->transform))
+    {
+      width = mode->height;
+      height = mode->width;
+    }
+  else
+    {
+      width = mode->width;
+      height = mode->height;
+    }
+
+  return (width == output_config->rect.width &&
+          height == output_config->rect.height);
+}
+
+/* Lists the CRTC and mode combinations that can drive @output as
+ * configured by @output_config. For every CRTC, the modes with the
+ * configured refresh rate come first, then those with any other. */
+static GArray *
+find_crtc_candidates (MetaMonitorManager *manager,
+                      MetaOutput         *output,
+                      MetaOutputConfig   *output_config)
+{
+  MetaMonitorMode *modes;
+  MetaCRTC *crtcs;
+  unsigned int n_crtcs, n_modes;
+  GArray *candidates;
+  unsigned int i, j, pass;
+
+  meta_monitor_manager_get_resources (manager,
+                                      &modes, &n_modes,
+                                      &crtcs, &n_crtcs,
+                                      NULL, NULL);
+
+  candidates = g_array_new (FALSE, FALSE, sizeof (CrtcCandidate));
+
+  if (!output)
+    return candidates;
+
+  for (i = 0; i < n_crtcs; i++)
+    {
+      MetaCRTC *crtc = &crtcs[i];
+
+      if (!crtc_can_drive_output (crtc, output))
+        continue;
+
+      if ((crtc->all_transforms & (1 << output_config->transform)) == 0)
+        continue;
+
+      for (pass = 0; pass < 2; pass++)
+        {
+          for (j = 0; j < n_modes; j++)
+            {
+              MetaMonitorMode *mode = &modes[j];
+              CrtcCandidate candidate;
+
+              if (!mode_matches_output_config (mode, output_config))
+                continue;
+
+              if ((mode->refresh_rate == output_config->refresh_rate) != (pass == 0))
+                continue;
+
+              if (!output_supports_mode (output, mode))
+                continue;
+
+              candidate.crtc = crtc;
+              candidate.mode = mode;
+              g_array_append_val (candidates, candidate);
+            }
+        }
+    }
+
+  return candidates;
+}
+
+static gboolean
+can_join_assigned_crtc (CrtcAssignment *assignment,
+                        unsigned int    output_num)
+{
+  MetaOutputConfig *output_config = &assignment->config->outputs[output_num];
+  GArray *candidates = assignment->candidates[output_num];
+  unsigned int i;
+
+  for (i = 0; i < candidates->len; i++)
+    {
+      CrtcCandidate *candidate = &g_array_index (candidates, CrtcCandidate, i);
+      MetaCRTCInfo *info = g_hash_table_lookup (assignment->info, candidate->crtc);
+
+      if (info &&
+          info->mode == candidate->mode &&
+          info->x == output_config->rect.x &&
+          info->y == output_config->rect.y &&
+          info->transform == output_config->transform &&
+          can_clone (info, assignment->outputs[output_num]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+find_augmenting_path (const gboolean *can_use,
+                      unsigned int    n_crtcs,
+                      unsigned int    group,
+                      int            *crtc_groups,
+                      gboolean       *visited)
+{
+  unsigned int i;
+
+  for (i = 0; i < n_crtcs; i++)
+    {
+      if (!can_use[group * n_crtcs + i] || visited[i])
+        continue;
+
+      visited[i] = TRUE;
+
+      if (crtc_groups[i] < 0 ||
+          find_augmenting_path (can_use, n_crtcs, crtc_groups[i],
+                                crtc_groups, visited))
+        {
+          crtc_groups[i] = group;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* Checks a necessary condition for the outputs from @output_num on to
+ * be assignable, given the CRTCs assigned so far.
+ *
+ * Outputs can only share a CRTC if they agree on position, size and
+ * transform, so grouping the outputs by those, each group that can't
+ * clone onto an already assigned CRTC needs a free CRTC of its own.
+ * That is a bipartite matching between groups and free CRTCs. */
+static gboolean
+remaining_outputs_can_fit (CrtcAssignment *assignment,
+                           unsigned int    output_num)
+{
+  MetaConfiguration *config = assignment->config;
+  MetaCRTC *crtcs;
+  unsigned int n_crtcs;
+  unsigned int *group_leaders;
+  unsigned int n_groups = 0;
+  gboolean *can_use;
+  gboolean *visited;
+  int *crtc_groups;
+  gboolean ok = TRUE;
+  unsigned int i, j;
+
+  meta_monitor_manager_get_resources (assignment->manager,
+                                      NULL, NULL,
+                                      &crtcs, &n_crtcs,
+                                      NULL, NULL);
+
+  group_leaders = g_new (unsigned int, config->n_outputs);
+  can_use = g_new0 (gboolean, config->n_outputs * n_crtcs);
+
+  for (i = output_num; i < config->n_outputs && ok; i++)
+    {
+      MetaOutputConfig *output_config = &config->outputs[i];
+      GArray *candidates = assignment->candidates[i];
+      gboolean has_free_crtc = FALSE;
+      unsigned int group;
+
+      if (!output_config->enabled)
+        continue;
+
+      if (can_join_assigned_crtc (assignment, i))
+        continue;
+
+      for (group = 0; group < n_groups; group++)
+        {
+          MetaOutputConfig *leader = &config->outputs[group_leaders[group]];
+
+          if (meta_rectangle_equal (&leader->rect, &output_config->rect) &&
+              leader->transform == output_config->transform)
+            break;
+        }
+
+      if (group == n_groups)
+        group_leaders[n_groups++] = i;
+
+      for (j = 0; j < candidates->len; j++)
+        {
+          CrtcCandidate *candidate = &g_array_index (candidates, CrtcCandidate, j);
+
+          if (g_hash_table_contains (assignment->info, candidate->crtc))
+            continue;
+
+          can_use[group * n_crtcs + (candidate->crtc - crtcs)] = TRUE;
+          has_free_crtc = TRUE;
+        }
+
+      ok = has_free_crtc;
+    }
+
+  if (ok && n_groups > 1)
+    {
+      crtc_groups = g_new (int, n_crtcs);
+      visited = g_new (gboolean, n_crtcs);
+
+      for (i = 0; i < n_crtcs; i++)
+        crtc_groups[i] = -1;
+
+      for (i = 0; i < n_groups && ok; i++)
+        {
+          memset (visited, 0, n_crtcs * sizeof (gboolean));
+          ok = find_augmenting_path (can_use, n_crtcs, i, crtc_groups, visited);
+        }
+
+      g_free (crtc_groups);
+      g_free (visited);
+    }
+
+  g_free (group_leaders);
+  g_free (can_use);
+
+  return ok;
+}
+
 /* Check whether the given set of settings can be used
  * at the same time -- ie. whether there is an assignment
  * of CRTC's to outputs.
  *
- * Brute force - the number of objects involved is small
- * enough that it doesn't matter.
+ * This is a backtracking search over the candidates of each output,
+ * pruned by remaining_outputs_can_fit() so that configurations that
+ * can't be assigned fail early instead of exhausting every combination.
  */
 static gboolean
 real_assign_crtcs (CrtcAssignment     *assignment,
                    unsigned int        output_num)
 {
-  MetaMonitorMode *modes;
-  MetaCRTC *crtcs;
-  MetaOutput *outputs;
-  unsigned int n_crtcs, n_modes, n_outputs;
-  MetaOutputKey *output_key;
   MetaOutputConfig *output_config;
+  GArray *candidates;
   unsigned int i;
 
   if (output_num == assignment->config->n_outputs)
     return TRUE;
 
-  output_key = &assignment->config->keys[output_num];
   output_config = &assignment->config->outputs[output_num];
 
   /* It is always allowed for an output to be turned off */
   if (!output_config->enabled)
     return real_assign_crtcs (assignment, output_num + 1);
 
-  meta_monitor_manager_get_resources (assignment->manager,
-                                      &modes, &n_modes,
-                                      &crtcs, &n_crtcs,
-                                      &outputs, &n_outputs);
+  if (!remaining_outputs_can_fit (assignment, output_num))
+    return FALSE;
 
-  for (i = 0; i < n_crtcs; i++)
+  candidates = assignment->candidates[output_num];
+  for (i = 0; i < candidates->len; i++)
     {
-      MetaCRTC *crtc = &crtcs[i];
-      unsigned int pass;
-
-      /* Make two passes, one where frequencies must match, then
-       * one where they don't have to
-       */
-      for (pass = 0; pass < 2; pass++)
-	{
-          MetaOutput *output = find_output_by_key (outputs, n_outputs, output_key);
-          unsigned int j;
-
-          for (j = 0; j < n_modes; j++)
-	    {
-              MetaMonitorMode *mode = &modes[j];
-              int width, height;
-
-              if (meta_monitor_transform_is_rotated (output_config->transform))
-                {
-                  width = mode->height;
-                  height = mode->width;
-                }
-              else
-                {
-                  width = mode->width;
-                  height = mode->height;
-                }
+      CrtcCandidate *candidate = &g_array_index (candidates, CrtcCandidate, i);
+      MetaCRTC *crtc = candidate->crtc;
+      MetaMonitorMode *mode = candidate->mode;
+      MetaOutput *output = assignment->outputs[output_num];
+
+      meta_verbose ("CRTC %ld: trying mode %dx%d@%fHz with output at %dx%d@%fHz (transform %d)\n",
+                    crtc->crtc_id,
+                    mode->width, mode->height, mode->refresh_rate,
+                    output_config->rect.width, output_config->rect.height, output_config->refresh_rate,
+                    output_config->transform);
+
+      if (crtc_assignment_assign (assignment, crtc, mode,
+                                  output_config->rect.x, output_config->rect.y,
+                                  output_config->transform,
+                                  output))
+        {
+          if (real_assign_crtcs (assignment, output_num + 1))
+            return TRUE;
 
-              if (width == output_config->rect.width &&
-                  height == output_config->rect.height &&
-                  (pass == 1 || mode->refresh_rate == output_config->refresh_rate))
-		{
-                  meta_verbose ("CRTC %ld: trying mode %dx%d@%fHz with output at %dx%d@%fHz (transform %d) (pass %d)\n",
-                                crtc->crtc_id,
-                                mode->width, mode->height, mode->refresh_rate,
-                                output_config->rect.width, output_config->rect.height, output_config->refresh_rate,
-                                output_config->transform,
-                                pass);
-
-                  if (crtc_assignment_assign (assignment, crtc, &modes[j],
-                                              output_config->rect.x, output_config->rect.y,
-                                              output_config->transform,
-                                              output))
-                    {
-                      if (real_assign_crtcs (assignment, output_num + 1))
-                        return TRUE;
-
-                      crtc_assignment_unassign (assignment, crtc, output);
-                    }
-                }
-            }
-	}
+          crtc_assignment_unassign (assignment, crtc, output);
+        }
     }
 
   return FALSE;
@@ -2041,12 +2355,38 @@ meta_monitor_config_assign_crtcs (MetaConfiguration  *config,
   unsigned int i;
   MetaOutput *all_outputs;
   unsigned int n_outputs;
+  gboolean ok;
+
+  all_outputs = meta_monitor_manager_get_outputs (manager,
+                                                  &n_outputs);
 
   assignment.config = config;
   assignment.manager = manager;
   assignment.info = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)meta_crtc_info_free);
+  assignment.outputs = g_new0 (MetaOutput *, config->n_outputs);
+  assignment.candidates = g_new0 (GArray *, config->n_outputs);
 
-  if (!real_assign_crtcs (&assignment, 0))
+  for (i = 0; i < config->n_outputs; i++)
+    {
+      if (!config->outputs[i].enabled)
+        continue;
+
+      assignment.outputs[i] = find_output_by_key (all_outputs, n_outputs,
+                                                  &config->keys[i]);
+      assignment.candidates[i] = find_crtc_candidates (manager,
+                                                       assignment.outputs[i],
+                                                       &config->outputs[i]);
+    }
+
+  ok = real_assign_crtcs (&assignment, 0);
+
+  for (i = 0; i < config->n_outputs; i++)
+    if (assignment.candidates[i])
+      g_array_free (assignment.candidates[i], TRUE);
+  g_free (assignment.candidates);
+  g_free (assignment.outputs);
+
+  if (!ok)
     {
       meta_warning ("Could not assign CRTC to outputs, ignoring configuration\n");
 
@@ -2061,8 +2401,6 @@ meta_monitor_config_assign_crtcs (MetaConfiguration  *config,
       g_ptr_array_add (crtcs, info);
     }
 
-  all_outputs = meta_monitor_manager_get_outputs (manager,
-                                                  &n_outputs);
   if (n_outputs != config->n_outputs)
     {
       g_hash_table_destroy (assignment.info);
@@ -34,6 +34,8 @@
 
 GType meta_monitor_config_get_type (void) G_GNUC_CONST;
 
+void               meta_monitor_config_preload (void);
+
 MetaMonitorConfig *meta_monitor_config_new (void);
 
 gboolean           meta_monitor_config_apply_stored (MetaMonitorConfig  *config,
@@ -169,12 +169,13 @@ meta_monitor_manager_dummy_read_current (MetaMonitorManager *manager)
     }
 }
 
-static void
+static gboolean
 meta_monitor_manager_dummy_apply_config (MetaMonitorManager *manager,
                                          MetaCRTCInfo       **crtcs,
                                          unsigned int         n_crtcs,
                                          MetaOutputInfo     **outputs,
-                                         unsigned int         n_outputs)
+                                         unsigned int         n_outputs,
+                                         GError             **error)
 {
     unsigned i;
     int screen_width = 0, screen_height = 0;
@@ -281,6 +282,8 @@ meta_monitor_manager_dummy_apply_config (MetaMonitorManager *manager,
   manager->screen_height = screen_height;
 
   meta_monitor_manager_rebuild_derived (manager);
+
+  return TRUE;
 }
 
 static void
@@ -308,6 +308,17 @@ struct _MetaMonitorManager
   unsigned int n_monitor_infos;
   int primary_monitor_index;
 
+  /* The monitor edges split the layout into a grid of cells, each either
+     entirely inside one monitor or outside all of them. This maps the
+     cells to monitor indices (or -1), so that finding the monitor at a
+     point is a lookup rather than a scan over monitor_infos.
+  */
+  int *monitor_grid_xs;
+  unsigned int n_monitor_grid_xs;
+  int *monitor_grid_ys;
+  unsigned int n_monitor_grid_ys;
+  int *monitor_grid;
+
   int dbus_name_id;
 
   int persistent_timeout_id;
@@ -327,11 +338,12 @@ struct _MetaMonitorManagerClass
   GBytes* (*read_edid) (MetaMonitorManager *,
                         MetaOutput         *);
 
-  void (*apply_configuration) (MetaMonitorManager  *,
-                               MetaCRTCInfo       **,
-                               unsigned int         ,
-                               MetaOutputInfo     **,
-                               unsigned int);
+  gboolean (*apply_configuration) (MetaMonitorManager  *,
+                                   MetaCRTCInfo       **,
+                                   unsigned int         ,
+                                   MetaOutputInfo     **,
+                                   unsigned int         ,
+                                   GError             **);
 
   void (*set_power_save_mode) (MetaMonitorManager *,
                                MetaPowerSave);
@@ -387,11 +399,12 @@ void                meta_monitor_manager_get_screen_limits (MetaMonitorManager *
                                                             int                *width,
                                                             int                *height);
 
-void                meta_monitor_manager_apply_configuration (MetaMonitorManager  *manager,
+gboolean            meta_monitor_manager_apply_configuration (MetaMonitorManager  *manager,
                                                               MetaCRTCInfo       **crtcs,
                                                               unsigned int         n_crtcs,
                                                               MetaOutputInfo     **outputs,
-                                                              unsigned int         n_outputs);
+                                                              unsigned int         n_outputs,
+                                                              GError             **error);
 
 void                meta_monitor_manager_confirm_configuration (MetaMonitorManager *manager,
                                                                 gboolean            ok);
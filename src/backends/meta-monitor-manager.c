@@ -165,6 +165,139 @@ construct_tile_monitor (MetaMonitorManager *manager,
   g_array_append_val (monitor_infos, info);
 }
 
+static int
+compare_ints (gconstpointer a,
+              gconstpointer b)
+{
+  int one = *(const int *) a;
+  int two = *(const int *) b;
+
+  return (one > two) - (one < two);
+}
+
+/* Sorts @values and removes duplicates, returning the new length */
+static unsigned int
+sort_unique_ints (int          *values,
+                  unsigned int  n_values)
+{
+  unsigned int i, n_unique;
+
+  if (n_values == 0)
+    return 0;
+
+  qsort (values, n_values, sizeof (int), compare_ints);
+
+  n_unique = 1;
+  for (i = 1; i < n_values; i++)
+    if (values[i] != values[n_unique - 1])
+      values[n_unique++] = values[i];
+
+  return n_unique;
+}
+
+static void
+clear_monitor_grid (MetaMonitorManager *manager)
+{
+  g_clear_pointer (&manager->monitor_grid_xs, g_free);
+  g_clear_pointer (&manager->monitor_grid_ys, g_free);
+  g_clear_pointer (&manager->monitor_grid, g_free);
+  manager->n_monitor_grid_xs = 0;
+  manager->n_monitor_grid_ys = 0;
+}
+
+/*
+ * build_monitor_grid:
+ *
+ * Build the grid used by meta_monitor_manager_get_monitor_at_point()
+ * from the monitor_infos. Where monitors overlap, a cell maps to the
+ * first of them, as a scan over monitor_infos would find.
+ */
+static void
+build_monitor_grid (MetaMonitorManager *manager)
+{
+  unsigned int n_columns, n_rows;
+  unsigned int i, column, row;
+
+  clear_monitor_grid (manager);
+
+  if (manager->n_monitor_infos == 0)
+    return;
+
+  manager->monitor_grid_xs = g_new (int, manager->n_monitor_infos * 2);
+  manager->monitor_grid_ys = g_new (int, manager->n_monitor_infos * 2);
+  for (i = 0; i < manager->n_monitor_infos; i++)
+    {
+      MetaRectangle *rect = &manager->monitor_infos[i].rect;
+
+      manager->monitor_grid_xs[i * 2] = rect->x;
+      manager->monitor_grid_xs[i * 2 + 1] = rect->x + rect->width;
+      manager->monitor_grid_ys[i * 2] = rect->y;
+      manager->monitor_grid_ys[i * 2 + 1] = rect->y + rect->height;
+    }
+
+  manager->n_monitor_grid_xs =
+    sort_unique_ints (manager->monitor_grid_xs, manager->n_monitor_infos * 2);
+  manager->n_monitor_grid_ys =
+    sort_unique_ints (manager->monitor_grid_ys, manager->n_monitor_infos * 2);
+
+  n_columns = manager->n_monitor_grid_xs - 1;
+  n_rows = manager->n_monitor_grid_ys - 1;
+  manager->monitor_grid = g_new (int, MAX (n_columns * n_rows, 1));
+
+  for (row = 0; row < n_rows; row++)
+    {
+      for (column = 0; column < n_columns; column++)
+        {
+          MetaRectangle cell = {
+            .x = manager->monitor_grid_xs[column],
+            .y = manager->monitor_grid_ys[row],
+            .width = 1,
+            .height = 1,
+          };
+          int monitor = -1;
+
+          for (i = 0; i < manager->n_monitor_infos; i++)
+            {
+              if (meta_rectangle_contains_rect (&manager->monitor_infos[i].rect,
+                                                &cell))
+                {
+                  monitor = i;
+                  break;
+                }
+            }
+
+          manager->monitor_grid[row * n_columns + column] = monitor;
+        }
+    }
+}
+
+/* Returns the index of the grid cell containing @value along an axis with
+ * the @n_edges sorted @edges, or -1 if @value is outside all of them */
+static int
+find_monitor_grid_cell (const int    *edges,
+                        unsigned int  n_edges,
+                        gfloat        value)
+{
+  unsigned int low, high;
+
+  if (n_edges < 2 || value < edges[0] || value >= edges[n_edges - 1])
+    return -1;
+
+  low = 0;
+  high = n_edges - 1;
+  while (high - low > 1)
+    {
+      unsigned int mid = low + (high - low) / 2;
+
+      if (value < edges[mid])
+        high = mid;
+      else
+        low = mid;
+    }
+
+  return low;
+}
+
 /*
  * make_logical_config:
  *
@@ -285,6 +418,8 @@ make_logical_config (MetaMonitorManager *manager)
   manager->n_monitor_infos = monitor_infos->len;
   manager->monitor_infos = (void*)g_array_free (monitor_infos, FALSE);
 
+  build_monitor_grid (manager);
+
   // disable it for deepin 
 #if 0
   if (manager_class->add_monitor)
@@ -436,6 +571,7 @@ meta_monitor_manager_finalize (GObject *object)
   meta_monitor_manager_free_mode_array (manager->modes, manager->n_modes);
   meta_monitor_manager_free_crtc_array (manager->crtcs, manager->n_crtcs);
   g_free (manager->monitor_infos);
+  clear_monitor_grid (manager);
 
   G_OBJECT_CLASS (meta_monitor_manager_parent_class)->finalize (object);
 }
@@ -778,16 +914,18 @@ output_can_clone (MetaOutput *output,
   return ok;
 }
 
-void
+gboolean
 meta_monitor_manager_apply_configuration (MetaMonitorManager *manager,
                                           MetaCRTCInfo       **crtcs,
                                           unsigned int         n_crtcs,
                                           MetaOutputInfo     **outputs,
-                                          unsigned int         n_outputs)
+                                          unsigned int         n_outputs,
+                                          GError             **error)
 {
-  META_MONITOR_MANAGER_GET_CLASS (manager)->apply_configuration (manager,
-                                                                 crtcs, n_crtcs,
-                                                                 outputs, n_outputs);
+  return META_MONITOR_MANAGER_GET_CLASS (manager)->apply_configuration (manager,
+                                                                        crtcs, n_crtcs,
+                                                                        outputs, n_outputs,
+                                                                        error);
 }
 
 static gboolean
@@ -818,6 +956,8 @@ meta_monitor_manager_handle_apply_configuration  (MetaDBusDisplayConfig *skeleto
   guint transform;
   guint output_index;
   GPtrArray *crtc_infos, *output_infos;
+  GError *error = NULL;
+  gboolean ok;
 
   if (serial != manager->serial)
     {
@@ -1009,15 +1149,26 @@ meta_monitor_manager_handle_apply_configuration  (MetaDBusDisplayConfig *skeleto
       manager->persistent_timeout_id = 0;
     }
 
-  meta_monitor_manager_apply_configuration (manager,
-                                            (MetaCRTCInfo**)crtc_infos->pdata,
-                                            crtc_infos->len,
-                                            (MetaOutputInfo**)output_infos->pdata,
-                                            output_infos->len);
+  ok = meta_monitor_manager_apply_configuration (manager,
+                                                 (MetaCRTCInfo**)crtc_infos->pdata,
+                                                 crtc_infos->len,
+                                                 (MetaOutputInfo**)output_infos->pdata,
+                                                 output_infos->len,
+                                                 &error);
 
   g_ptr_array_unref (crtc_infos);
   g_ptr_array_unref (output_infos);
 
+  /* Don't ask the user to confirm a configuration that isn't there */
+  if (!ok)
+    {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                                             G_DBUS_ERROR_FAILED,
+                                             "%s", error->message);
+      g_error_free (error);
+      return TRUE;
+    }
+
   /* Update MetaMonitorConfig data structures immediately so that we
      don't revert the change at the next XRandR event, then ask the plugin
      manager (through MetaScreen) to confirm the display change with the
@@ -1423,43 +1574,108 @@ meta_monitor_manager_rebuild_derived (MetaMonitorManager *manager)
   g_free (old_monitor_infos);
 }
 
-void
-meta_output_parse_edid (MetaOutput *meta_output,
-                        GBytes     *edid)
+typedef struct
 {
+  char *vendor;
+  char *product;
+  char *serial;
+} ParsedEdid;
+
+/* Outputs are recreated every time the resources are read, usually with
+ * the same monitors connected, so keep the strings parsed from the EDIDs
+ * seen recently. */
+#define MAX_CACHED_EDIDS 16
+
+static GHashTable *parsed_edids = NULL;
+
+static void
+parsed_edid_free (ParsedEdid *parsed)
+{
+  g_free (parsed->vendor);
+  g_free (parsed->product);
+  g_free (parsed->serial);
+  g_slice_free (ParsedEdid, parsed);
+}
+
+static ParsedEdid *
+parse_edid (GBytes *edid)
+{
+  ParsedEdid *parsed;
   MonitorInfo *parsed_edid;
   gsize len;
 
-  if (!edid)
-    goto out;
+  parsed = g_slice_new0 (ParsedEdid);
 
   parsed_edid = decode_edid (g_bytes_get_data (edid, &len));
 
   if (parsed_edid)
     {
-      meta_output->vendor = g_strndup (parsed_edid->manufacturer_code, 4);
-      if (!g_utf8_validate (meta_output->vendor, -1, NULL))
-        g_clear_pointer (&meta_output->vendor, g_free);
+      parsed->vendor = g_strndup (parsed_edid->manufacturer_code, 4);
+      if (!g_utf8_validate (parsed->vendor, -1, NULL))
+        g_clear_pointer (&parsed->vendor, g_free);
 
-      meta_output->product = g_strndup (parsed_edid->dsc_product_name, 14);
-      if (!g_utf8_validate (meta_output->product, -1, NULL) ||
-          meta_output->product[0] == '\0')
+      parsed->product = g_strndup (parsed_edid->dsc_product_name, 14);
+      if (!g_utf8_validate (parsed->product, -1, NULL) ||
+          parsed->product[0] == '\0')
         {
-          g_clear_pointer (&meta_output->product, g_free);
-          meta_output->product = g_strdup_printf ("0x%04x", (unsigned) parsed_edid->product_code);
+          g_clear_pointer (&parsed->product, g_free);
+          parsed->product = g_strdup_printf ("0x%04x", (unsigned) parsed_edid->product_code);
         }
 
-      meta_output->serial = g_strndup (parsed_edid->dsc_serial_number, 14);
-      if (!g_utf8_validate (meta_output->serial, -1, NULL) ||
-          meta_output->serial[0] == '\0')
+      parsed->serial = g_strndup (parsed_edid->dsc_serial_number, 14);
+      if (!g_utf8_validate (parsed->serial, -1, NULL) ||
+          parsed->serial[0] == '\0')
         {
-          g_clear_pointer (&meta_output->serial, g_free);
-          meta_output->serial = g_strdup_printf ("0x%08x", parsed_edid->serial_number);
+          g_clear_pointer (&parsed->serial, g_free);
+          parsed->serial = g_strdup_printf ("0x%08x", parsed_edid->serial_number);
         }
 
       g_free (parsed_edid);
     }
 
+  return parsed;
+}
+
+static ParsedEdid *
+lookup_parsed_edid (GBytes *edid)
+{
+  ParsedEdid *parsed;
+
+  if (!parsed_edids)
+    parsed_edids = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                          (GDestroyNotify) g_bytes_unref,
+                                          (GDestroyNotify) parsed_edid_free);
+
+  parsed = g_hash_table_lookup (parsed_edids, edid);
+  if (parsed)
+    return parsed;
+
+  /* Only a handful of monitors are ever connected, so rather than
+   * tracking which entries are stale, start over when it grows. */
+  if (g_hash_table_size (parsed_edids) >= MAX_CACHED_EDIDS)
+    g_hash_table_remove_all (parsed_edids);
+
+  parsed = parse_edid (edid);
+  g_hash_table_insert (parsed_edids, g_bytes_ref (edid), parsed);
+
+  return parsed;
+}
+
+void
+meta_output_parse_edid (MetaOutput *meta_output,
+                        GBytes     *edid)
+{
+  ParsedEdid *parsed;
+
+  if (!edid)
+    goto out;
+
+  parsed = lookup_parsed_edid (edid);
+
+  meta_output->vendor = g_strdup (parsed->vendor);
+  meta_output->product = g_strdup (parsed->product);
+  meta_output->serial = g_strdup (parsed->serial);
+
  out:
   if (!meta_output->vendor)
     meta_output->vendor = g_strdup ("unknown");
@@ -1594,23 +1810,19 @@ meta_monitor_manager_get_monitor_at_point (MetaMonitorManager *manager,
                                            gfloat              x,
                                            gfloat              y)
 {
-  unsigned int i;
+  int column, row;
 
-  for (i = 0; i < manager->n_monitor_infos; i++)
-    {
-      MetaMonitorInfo *monitor = &manager->monitor_infos[i];
-      int left, right, top, bottom;
-
-      left = monitor->rect.x;
-      right = left + monitor->rect.width;
-      top = monitor->rect.y;
-      bottom = top + monitor->rect.height;
+  column = find_monitor_grid_cell (manager->monitor_grid_xs,
+                                   manager->n_monitor_grid_xs, x);
+  if (column < 0)
+    return -1;
 
-      if ((x >= left) && (x < right) && (y >= top) && (y < bottom))
-	return i;
-    }
+  row = find_monitor_grid_cell (manager->monitor_grid_ys,
+                                manager->n_monitor_grid_ys, y);
+  if (row < 0)
+    return -1;
 
-  return -1;
+  return manager->monitor_grid[row * (manager->n_monitor_grid_xs - 1) + column];
 }
 
 gboolean
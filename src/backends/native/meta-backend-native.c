@@ -170,45 +170,41 @@ constrain_to_client_constraint (ClutterInputDevice *device,
 
 static void
 constrain_all_screen_monitors (ClutterInputDevice *device,
-			       MetaMonitorInfo    *monitors,
-			       unsigned            n_monitors,
-			       float              *x,
-			       float              *y)
+                               MetaMonitorManager *monitor_manager,
+                               float              *x,
+                               float              *y)
 {
   ClutterPoint current;
-  unsigned int i;
-  float cx, cy;
+  MetaMonitorInfo *monitors;
+  MetaMonitorInfo *monitor;
+  unsigned int n_monitors;
+  int left, right, top, bottom;
+  int i;
 
   clutter_input_device_get_coords (device, NULL, &current);
 
-  cx = current.x;
-  cy = current.y;
-
   /* if we're trying to escape, clamp to the CRTC we're coming from */
-  for (i = 0; i < n_monitors; i++)
-    {
-      MetaMonitorInfo *monitor = &monitors[i];
-      int left, right, top, bottom;
-
-      left = monitor->rect.x;
-      right = left + monitor->rect.width;
-      top = monitor->rect.y;
-      bottom = top + monitor->rect.height;
-
-      if ((cx >= left) && (cx < right) && (cy >= top) && (cy < bottom))
-	{
-	  if (*x < left)
-	    *x = left;
-	  if (*x >= right)
-	    *x = right - 1;
-	  if (*y < top)
-	    *y = top;
-	  if (*y >= bottom)
-	    *y = bottom - 1;
-
-	  return;
-        }
-    }
+  i = meta_monitor_manager_get_monitor_at_point (monitor_manager,
+                                                 current.x, current.y);
+  if (i < 0)
+    return;
+
+  monitors = meta_monitor_manager_get_monitor_infos (monitor_manager, &n_monitors);
+  monitor = &monitors[i];
+
+  left = monitor->rect.x;
+  right = left + monitor->rect.width;
+  top = monitor->rect.y;
+  bottom = top + monitor->rect.height;
+
+  if (*x < left)
+    *x = left;
+  if (*x >= right)
+    *x = right - 1;
+  if (*y < top)
+    *y = top;
+  if (*y >= bottom)
+    *y = bottom - 1;
 }
 
 static void
@@ -221,8 +217,6 @@ pointer_constrain_callback (ClutterInputDevice *device,
                             gpointer            user_data)
 {
   MetaMonitorManager *monitor_manager;
-  MetaMonitorInfo *monitors;
-  unsigned int n_monitors;
 
   /* Constrain to barriers */
   constrain_to_barriers (device, time, new_x, new_y);
@@ -231,14 +225,16 @@ pointer_constrain_callback (ClutterInputDevice *device,
   constrain_to_client_constraint (device, time, prev_x, prev_y, new_x, new_y);
 
   monitor_manager = meta_monitor_manager_get ();
-  monitors = meta_monitor_manager_get_monitor_infos (monitor_manager, &n_monitors);
-
-  /* if we're moving inside a monitor, we're fine */
-  if (meta_monitor_manager_get_monitor_at_point (monitor_manager, *new_x, *new_y) >= 0)
-    return;
 
   /* if we're trying to escape, clamp to the CRTC we're coming from */
-  constrain_all_screen_monitors(device, monitors, n_monitors, new_x, new_y);
+  if (meta_monitor_manager_get_monitor_at_point (monitor_manager, *new_x, *new_y) < 0)
+    constrain_all_screen_monitors (device, monitor_manager, new_x, new_y);
+
+  /* This runs as soon as the motion is read from the device, while the
+   * event itself is only processed on the next frame. Move the cursor
+   * now, so that it doesn't lag behind when painting a frame takes long. */
+  meta_cursor_tracker_update_position (meta_cursor_tracker_get_for_screen (NULL),
+                                       *new_x, *new_y);
 }
 
 static void
@@ -36,6 +36,7 @@
 #include <meta/util.h>
 #include "backends/meta-backend-private.h"
 #include "backends/meta-barrier-private.h"
+#include "backends/meta-barrier-index.h"
 #include "backends/native/meta-backend-native.h"
 #include "backends/native/meta-backend-native-private.h"
 #include "backends/native/meta-barrier-native.h"
@@ -43,6 +44,14 @@
 struct _MetaBarrierManagerNative
 {
   GHashTable *barriers;
+
+  /* Horizontal barriers indexed by y, vertical ones by x */
+  MetaBarrierIndex *horizontal_barriers;
+  MetaBarrierIndex *vertical_barriers;
+
+  /* Barriers not in the active state, i.e. the ones interacting with the
+   * pointer */
+  GHashTable *engaged_barriers;
 };
 
 typedef enum {
@@ -107,13 +116,51 @@ is_barrier_blocking_directions (MetaBarrier         *barrier,
                                              directions);
 }
 
+static float
+get_barrier_position (MetaBarrierImplNative *self)
+{
+  MetaBarrierImplNativePrivate *priv =
+    meta_barrier_impl_native_get_instance_private (self);
+  MetaBarrier *barrier = priv->barrier;
+
+  if (is_barrier_horizontal (barrier))
+    return barrier->priv->border.line.a.y;
+  else
+    return barrier->priv->border.line.a.x;
+}
+
+static MetaBarrierIndex *
+get_barrier_index (MetaBarrierManagerNative *manager,
+                   MetaBarrierImplNative    *self)
+{
+  MetaBarrierImplNativePrivate *priv =
+    meta_barrier_impl_native_get_instance_private (self);
+
+  if (is_barrier_horizontal (priv->barrier))
+    return manager->horizontal_barriers;
+  else
+    return manager->vertical_barriers;
+}
+
 static void
-dismiss_pointer (MetaBarrierImplNative *self)
+set_barrier_state (MetaBarrierImplNative *self,
+                   MetaBarrierState       state)
 {
   MetaBarrierImplNativePrivate *priv =
     meta_barrier_impl_native_get_instance_private (self);
 
-  priv->state = META_BARRIER_STATE_LEFT;
+  priv->state = state;
+
+  if (state == META_BARRIER_STATE_ACTIVE)
+    g_hash_table_remove (priv->manager->engaged_barriers, self);
+  else
+    g_hash_table_add (priv->manager->engaged_barriers, self);
+}
+
+static void
+dismiss_pointer (MetaBarrierImplNative *self)
+{
+  set_barrier_state (self, META_BARRIER_STATE_LEFT);
 }
 
 /*
@@ -223,7 +270,8 @@ maybe_release_barriers (MetaBarrierManagerNative *manager,
     },
   };
 
-  g_hash_table_foreach (manager->barriers,
+  /* Only held barriers can be released. */
+  g_hash_table_foreach (manager->engaged_barriers,
                         maybe_release_barrier,
                         &motion);
 }
@@ -244,15 +292,14 @@ typedef struct _MetaClosestBarrierData
 } MetaClosestBarrierData;
 
 static void
-update_closest_barrier (gpointer key,
-                        gpointer value,
+update_closest_barrier (gpointer barrier_impl,
                         gpointer user_data)
 {
-  MetaBarrierImplNative *self = key;
+  MetaBarrierImplNative *self = barrier_impl;
+  MetaClosestBarrierData *data = user_data;
   MetaBarrierImplNativePrivate *priv =
     meta_barrier_impl_native_get_instance_private (self);
   MetaBarrier *barrier = priv->barrier;
-  MetaClosestBarrierData *data = user_data;
   MetaVector2 intersection;
   float dx, dy;
   float distance_2;
@@ -317,9 +364,14 @@ get_closest_barrier (MetaBarrierManagerNative *manager,
     },
   };
 
-  g_hash_table_foreach (manager->barriers,
-                        update_closest_barrier,
-                        &closest_barrier_data);
+  meta_barrier_index_foreach_in_range (manager->horizontal_barriers,
+                                       MIN (prev_y, y), MAX (prev_y, y),
+                                       update_closest_barrier,
+                                       &closest_barrier_data);
+  meta_barrier_index_foreach_in_range (manager->vertical_barriers,
+                                       MIN (prev_x, x), MAX (prev_x, x),
+                                       update_closest_barrier,
+                                       &closest_barrier_data);
 
   if (closest_barrier_data.out.barrier_impl != NULL)
     {
@@ -362,14 +414,14 @@ emit_barrier_event (MetaBarrierImplNative *self,
   switch (priv->state)
     {
     case META_BARRIER_STATE_HIT:
-      priv->state = META_BARRIER_STATE_HELD;
+      set_barrier_state (self, META_BARRIER_STATE_HELD);
       priv->trigger_serial = next_serial ();
       event->dt = 0;
 
       break;
     case META_BARRIER_STATE_RELEASE:
     case META_BARRIER_STATE_LEFT:
-      priv->state = META_BARRIER_STATE_ACTIVE;
+      set_barrier_state (self, META_BARRIER_STATE_ACTIVE);
 
       /* Intentional fall-through. */
     case META_BARRIER_STATE_HELD:
@@ -403,12 +455,11 @@ emit_barrier_event (MetaBarrierImplNative *self,
 }
 
 static void
-maybe_emit_barrier_event (gpointer key, gpointer value, gpointer user_data)
+maybe_emit_barrier_event (MetaBarrierImplNative *self,
+                          MetaBarrierEventData  *data)
 {
-  MetaBarrierImplNative *self = key;
   MetaBarrierImplNativePrivate *priv =
     meta_barrier_impl_native_get_instance_private (self);
-  MetaBarrierEventData *data = user_data;
 
   switch (priv->state) {
     case META_BARRIER_STATE_ACTIVE:
@@ -465,7 +516,7 @@ clamp_to_barrier (MetaBarrierImplNative *self,
                        META_BARRIER_DIRECTION_NEGATIVE_X);
     }
 
-  priv->state = META_BARRIER_STATE_HIT;
+  set_barrier_state (self, META_BARRIER_STATE_HIT);
 }
 
 void
@@ -483,6 +534,7 @@ meta_barrier_manager_native_process (MetaBarrierManagerNative *manager,
   MetaBarrierDirection motion_dir = 0;
   MetaBarrierEventData barrier_event_data;
   MetaBarrierImplNative *barrier_impl;
+  GList *engaged, *l;
 
   if (!clutter_input_device_get_coords (device, NULL, &prev_pos))
     return;
@@ -528,9 +580,17 @@ meta_barrier_manager_native_process (MetaBarrierManagerNative *manager,
     .dy = orig_y - prev_y,
   };
 
-  g_hash_table_foreach (manager->barriers,
-                        maybe_emit_barrier_event,
-                        &barrier_event_data);
+  /* Signal handlers may release or destroy barriers, and emitting moves
+   * barriers back to the active state, so iterate over a copy. */
+  engaged = g_hash_table_get_keys (manager->engaged_barriers);
+  for (l = engaged; l; l = l->next)
+    {
+      MetaBarrierImplNative *self = l->data;
+
+      if (g_hash_table_contains (manager->engaged_barriers, self))
+        maybe_emit_barrier_event (self, &barrier_event_data);
+    }
+  g_list_free (engaged);
 }
 
 static gboolean
@@ -553,7 +613,7 @@ _meta_barrier_impl_native_release (MetaBarrierImpl  *impl,
 
   if (priv->state == META_BARRIER_STATE_HELD &&
       event->event_id == priv->trigger_serial)
-    priv->state = META_BARRIER_STATE_RELEASE;
+    set_barrier_state (self, META_BARRIER_STATE_RELEASE);
 }
 
 static void
@@ -564,6 +624,8 @@ _meta_barrier_impl_native_destroy (MetaBarrierImpl *impl)
     meta_barrier_impl_native_get_instance_private (self);
 
   g_hash_table_remove (priv->manager->barriers, self);
+  g_hash_table_remove (priv->manager->engaged_barriers, self);
+  meta_barrier_index_remove (get_barrier_index (priv->manager, self), self);
   priv->is_active = FALSE;
 }
 
@@ -586,6 +648,9 @@ meta_barrier_impl_native_new (MetaBarrier *barrier)
   priv->manager = manager;
   g_hash_table_add (manager->barriers, self);
 
+  meta_barrier_index_add (get_barrier_index (manager, self), self,
+                          get_barrier_position (self));
+
   return META_BARRIER_IMPL (self);
 }
 
@@ -612,6 +677,9 @@ meta_barrier_manager_native_new (void)
   manager = g_new0 (MetaBarrierManagerNative, 1);
 
   manager->barriers = g_hash_table_new (NULL, NULL);
+  manager->horizontal_barriers = meta_barrier_index_new ();
+  manager->vertical_barriers = meta_barrier_index_new ();
+  manager->engaged_barriers = g_hash_table_new (NULL, NULL);
 
   return manager;
 }
@@ -57,8 +57,38 @@
  */
 #define HW_CURSOR_BUFFER_COUNT 3
 
+/* Cursor buffers are cached by content, so that cycling through the frames
+ * of an animated cursor, or setting the same image again, doesn't allocate
+ * and upload a new buffer each time. Buffers no longer used by any sprite
+ * are kept in a pool of this size; once it is full, the least recently
+ * used one is rewritten with the new content instead of allocating.
+ */
+#define MAX_POOLED_CURSOR_BOS 32
+
 static GQuark quark_cursor_sprite = 0;
 
+typedef struct _MetaCursorBo
+{
+  int ref_count;
+  struct gbm_bo *bo;
+
+  /* The padded pixel data the buffer was written with; NULL for buffers
+   * imported from a wl_buffer, which are never cached */
+  uint8_t *pixels;
+  size_t size;
+  uint32_t gbm_format;
+  guint hash;
+
+  MetaCursorRendererNative *native;
+  GList *pool_link;
+} MetaCursorBo;
+
+typedef struct _MetaCursorCrtcState
+{
+  int hot_x;
+  int hot_y;
+} MetaCursorCrtcState;
+
 struct _MetaCursorRendererNativePrivate
 {
   gboolean has_hw_cursor;
@@ -71,6 +101,13 @@ struct _MetaCursorRendererNativePrivate
 
   uint64_t cursor_width;
   uint64_t cursor_height;
+
+  GHashTable *bo_cache;
+  GQueue bo_pool;
+  uint8_t *upload_buffer;
+
+  /* Hotspot last set on each CRTC, by CRTC id */
+  GHashTable *crtc_states;
 };
 typedef struct _MetaCursorRendererNativePrivate MetaCursorRendererNativePrivate;
 
@@ -85,7 +122,7 @@ typedef struct _MetaCursorNativePrivate
 {
   guint active_bo;
   MetaCursorGbmBoState pending_bo_state;
-  struct gbm_bo *bos[HW_CURSOR_BUFFER_COUNT];
+  MetaCursorBo *bos[HW_CURSOR_BUFFER_COUNT];
 } MetaCursorNativePrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (MetaCursorRendererNative, meta_cursor_renderer_native, META_TYPE_CURSOR_RENDERER);
@@ -93,15 +130,126 @@ G_DEFINE_TYPE_WITH_PRIVATE (MetaCursorRendererNative, meta_cursor_renderer_nativ
 static MetaCursorNativePrivate *
 ensure_cursor_priv (MetaCursorSprite *cursor_sprite);
 
+static guint
+cursor_bo_hash (gconstpointer key)
+{
+  const MetaCursorBo *cursor_bo = key;
+
+  return cursor_bo->hash;
+}
+
+static gboolean
+cursor_bo_equal (gconstpointer a,
+                 gconstpointer b)
+{
+  const MetaCursorBo *one = a;
+  const MetaCursorBo *two = b;
+
+  return (one->hash == two->hash &&
+          one->gbm_format == two->gbm_format &&
+          one->size == two->size &&
+          memcmp (one->pixels, two->pixels, one->size) == 0);
+}
+
+static guint
+hash_cursor_pixels (const uint8_t *pixels,
+                    size_t         size)
+{
+  const uint32_t *words = (const uint32_t *) pixels;
+  guint hash = 5381;
+  size_t i;
+
+  for (i = 0; i < size / 4; i++)
+    hash = hash * 33 + words[i];
+
+  return hash;
+}
+
+static void
+cursor_bo_free (MetaCursorBo *cursor_bo)
+{
+  gbm_bo_destroy (cursor_bo->bo);
+  g_free (cursor_bo->pixels);
+  g_slice_free (MetaCursorBo, cursor_bo);
+}
+
+static void
+evict_pooled_cursor_bo (MetaCursorRendererNativePrivate *priv,
+                        MetaCursorBo                    *cursor_bo)
+{
+  g_hash_table_remove (priv->bo_cache, cursor_bo);
+  g_queue_delete_link (&priv->bo_pool, cursor_bo->pool_link);
+  cursor_bo->pool_link = NULL;
+}
+
+static MetaCursorBo *
+cursor_bo_ref (MetaCursorBo *cursor_bo)
+{
+  MetaCursorRendererNativePrivate *priv;
+
+  if (cursor_bo->ref_count++ == 0 && cursor_bo->pool_link)
+    {
+      priv = meta_cursor_renderer_native_get_instance_private (cursor_bo->native);
+      g_queue_delete_link (&priv->bo_pool, cursor_bo->pool_link);
+      cursor_bo->pool_link = NULL;
+    }
+
+  return cursor_bo;
+}
+
+static void
+cursor_bo_unref (MetaCursorBo *cursor_bo)
+{
+  MetaCursorRendererNativePrivate *priv;
+
+  if (--cursor_bo->ref_count > 0)
+    return;
+
+  if (!cursor_bo->pixels || !cursor_bo->native)
+    {
+      cursor_bo_free (cursor_bo);
+      return;
+    }
+
+  priv = meta_cursor_renderer_native_get_instance_private (cursor_bo->native);
+
+  g_queue_push_head (&priv->bo_pool, cursor_bo);
+  cursor_bo->pool_link = priv->bo_pool.head;
+
+  if (priv->bo_pool.length > MAX_POOLED_CURSOR_BOS)
+    {
+      MetaCursorBo *oldest = g_queue_peek_tail (&priv->bo_pool);
+
+      evict_pooled_cursor_bo (priv, oldest);
+      cursor_bo_free (oldest);
+    }
+}
+
 static void
 meta_cursor_renderer_native_finalize (GObject *object)
 {
   MetaCursorRendererNative *renderer = META_CURSOR_RENDERER_NATIVE (object);
   MetaCursorRendererNativePrivate *priv = meta_cursor_renderer_native_get_instance_private (renderer);
+  GHashTableIter iter;
+  MetaCursorBo *cursor_bo;
 
   if (priv->animation_timeout_id)
     g_source_remove (priv->animation_timeout_id);
 
+  /* Buffers still used by sprites are freed when those let go of them */
+  g_hash_table_iter_init (&iter, priv->bo_cache);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &cursor_bo, NULL))
+    {
+      if (cursor_bo->ref_count == 0)
+        cursor_bo_free (cursor_bo);
+      else
+        cursor_bo->native = NULL;
+    }
+  g_hash_table_destroy (priv->bo_cache);
+  g_queue_clear (&priv->bo_pool);
+  g_hash_table_destroy (priv->crtc_states);
+  g_free (priv->upload_buffer);
+
   G_OBJECT_CLASS (meta_cursor_renderer_native_parent_class)->finalize (object);
 }
 
@@ -114,7 +262,7 @@ get_pending_cursor_sprite_gbm_bo_index (MetaCursorSprite *cursor_sprite)
   return (cursor_priv->active_bo + 1) % HW_CURSOR_BUFFER_COUNT;
 }
 
-static struct gbm_bo *
+static MetaCursorBo *
 get_pending_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite)
 {
   MetaCursorNativePrivate *cursor_priv =
@@ -128,7 +276,7 @@ get_pending_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite)
   return cursor_priv->bos[pending_bo];
 }
 
-static struct gbm_bo *
+static MetaCursorBo *
 get_active_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite)
 {
   MetaCursorNativePrivate *cursor_priv =
@@ -142,7 +290,7 @@ get_active_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite)
 
 static void
 set_pending_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite,
-                                  struct gbm_bo    *bo)
+                                  MetaCursorBo     *bo)
 {
   MetaCursorNativePrivate *cursor_priv;
   guint pending_bo;
@@ -166,7 +314,8 @@ set_crtc_cursor (MetaCursorRendererNative *native,
     {
       MetaCursorNativePrivate *cursor_priv =
         g_object_get_qdata (G_OBJECT (cursor_sprite), quark_cursor_sprite);
-      struct gbm_bo *bo;
+      MetaCursorCrtcState *crtc_state;
+      MetaCursorBo *bo;
       union gbm_bo_handle handle;
       int hot_x, hot_y;
 
@@ -175,13 +324,28 @@ set_crtc_cursor (MetaCursorRendererNative *native,
       else
         bo = get_active_cursor_sprite_gbm_bo (cursor_sprite);
 
-      if (!force && bo == crtc->cursor_renderer_private)
+      meta_cursor_sprite_get_hotspot (cursor_sprite, &hot_x, &hot_y);
+
+      crtc_state = g_hash_table_lookup (priv->crtc_states,
+                                        GUINT_TO_POINTER (crtc->crtc_id));
+      if (!crtc_state)
+        {
+          crtc_state = g_new0 (MetaCursorCrtcState, 1);
+          g_hash_table_insert (priv->crtc_states,
+                               GUINT_TO_POINTER (crtc->crtc_id), crtc_state);
+        }
+
+      /* Cached buffers are shared between sprites with the same image, so
+       * the buffer alone doesn't tell whether the hotspot changed */
+      if (!force && bo == crtc->cursor_renderer_private &&
+          hot_x == crtc_state->hot_x && hot_y == crtc_state->hot_y)
         return;
 
       crtc->cursor_renderer_private = bo;
+      crtc_state->hot_x = hot_x;
+      crtc_state->hot_y = hot_y;
 
-      handle = gbm_bo_get_handle (bo);
-      meta_cursor_sprite_get_hotspot (cursor_sprite, &hot_x, &hot_y);
+      handle = gbm_bo_get_handle (bo->bo);
 
       drmModeSetCursor2 (priv->drm_fd, crtc->crtc_id, handle.u32,
                          priv->cursor_width, priv->cursor_height, hot_x, hot_y);
@@ -412,7 +576,7 @@ cursor_priv_free (gpointer data)
     return;
 
   for (i = 0; i < HW_CURSOR_BUFFER_COUNT; i++)
-    g_clear_pointer (&cursor_priv->bos[0], (GDestroyNotify) gbm_bo_destroy);
+    g_clear_pointer (&cursor_priv->bos[i], cursor_bo_unref);
   g_slice_free (MetaCursorNativePrivate, cursor_priv);
 }
 
@@ -434,6 +598,78 @@ ensure_cursor_priv (MetaCursorSprite *cursor_sprite)
   return cursor_priv;
 }
 
+static MetaCursorBo *
+cursor_bo_new (MetaCursorRendererNative *native,
+               struct gbm_bo            *bo)
+{
+  MetaCursorBo *cursor_bo;
+
+  cursor_bo = g_slice_new0 (MetaCursorBo);
+  cursor_bo->ref_count = 1;
+  cursor_bo->bo = bo;
+  cursor_bo->native = native;
+
+  return cursor_bo;
+}
+
+static MetaCursorBo *
+create_cached_cursor_bo (MetaCursorRendererNative *native,
+                         const MetaCursorBo       *lookup)
+{
+  MetaCursorRendererNativePrivate *priv =
+    meta_cursor_renderer_native_get_instance_private (native);
+  MetaCursorBo *cursor_bo = NULL;
+  struct gbm_bo *bo;
+
+  if (priv->bo_pool.length == MAX_POOLED_CURSOR_BOS)
+    {
+      MetaCursorBo *oldest = g_queue_peek_tail (&priv->bo_pool);
+
+      evict_pooled_cursor_bo (priv, oldest);
+
+      if (oldest->gbm_format == lookup->gbm_format)
+        {
+          cursor_bo = oldest;
+          cursor_bo->ref_count = 1;
+        }
+      else
+        {
+          cursor_bo_free (oldest);
+        }
+    }
+
+  if (!cursor_bo)
+    {
+      bo = gbm_bo_create (priv->gbm, priv->cursor_width, priv->cursor_height,
+                          lookup->gbm_format,
+                          GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE);
+      if (!bo)
+        {
+          meta_warning ("Failed to allocate HW cursor buffer\n");
+          return NULL;
+        }
+
+      cursor_bo = cursor_bo_new (native, bo);
+    }
+
+  if (gbm_bo_write (cursor_bo->bo, lookup->pixels, lookup->size) != 0)
+    {
+      meta_warning ("Failed to write cursors buffer data: %s",
+                    g_strerror (errno));
+      cursor_bo_free (cursor_bo);
+      return NULL;
+    }
+
+  g_free (cursor_bo->pixels);
+  cursor_bo->pixels = g_memdup (lookup->pixels, lookup->size);
+  cursor_bo->size = lookup->size;
+  cursor_bo->gbm_format = lookup->gbm_format;
+  cursor_bo->hash = lookup->hash;
+  g_hash_table_add (priv->bo_cache, cursor_bo);
+
+  return cursor_bo;
+}
+
 static void
 load_cursor_sprite_gbm_buffer (MetaCursorRendererNative *native,
                                MetaCursorSprite         *cursor_sprite,
@@ -459,30 +695,32 @@ load_cursor_sprite_gbm_buffer (MetaCursorRendererNative *native,
   if (gbm_device_is_format_supported (priv->gbm, gbm_format,
                                       GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE))
     {
-      struct gbm_bo *bo;
-      uint8_t buf[4 * cursor_width * cursor_height];
+      MetaCursorBo lookup = { 0 };
+      MetaCursorBo *cursor_bo;
+      uint8_t *buf;
       uint i;
 
-      bo = gbm_bo_create (priv->gbm, cursor_width, cursor_height,
-                          gbm_format, GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE);
-      if (!bo)
-        {
-          meta_warning ("Failed to allocate HW cursor buffer\n");
-          return;
-        }
+      lookup.size = 4 * cursor_width * cursor_height;
+      if (!priv->upload_buffer)
+        priv->upload_buffer = g_malloc (lookup.size);
+      buf = priv->upload_buffer;
 
-      memset (buf, 0, sizeof(buf));
+      memset (buf, 0, lookup.size);
       for (i = 0; i < height; i++)
         memcpy (buf + i * 4 * cursor_width, pixels + i * rowstride, width * 4);
-      if (gbm_bo_write (bo, buf, cursor_width * cursor_height * 4) != 0)
-        {
-          meta_warning ("Failed to write cursors buffer data: %s",
-                        g_strerror (errno));
-          gbm_bo_destroy (bo);
-          return;
-        }
 
-      set_pending_cursor_sprite_gbm_bo (cursor_sprite, bo);
+      lookup.pixels = buf;
+      lookup.gbm_format = gbm_format;
+      lookup.hash = hash_cursor_pixels (buf, lookup.size);
+
+      cursor_bo = g_hash_table_lookup (priv->bo_cache, &lookup);
+      if (cursor_bo)
+        cursor_bo_ref (cursor_bo);
+      else
+        cursor_bo = create_cached_cursor_bo (native, &lookup);
+
+      if (cursor_bo)
+        set_pending_cursor_sprite_gbm_bo (cursor_sprite, cursor_bo);
     }
   else
     {
@@ -501,8 +739,7 @@ invalidate_pending_cursor_sprite_gbm_bo (MetaCursorSprite *cursor_sprite)
     return;
 
   pending_bo = get_pending_cursor_sprite_gbm_bo_index (cursor_sprite);
-  g_clear_pointer (&cursor_priv->bos[pending_bo],
-                   (GDestroyNotify) gbm_bo_destroy);
+  g_clear_pointer (&cursor_priv->bos[pending_bo], cursor_bo_unref);
   cursor_priv->pending_bo_state = META_CURSOR_GBM_BO_STATE_INVALIDATED;
 }
 
@@ -596,7 +833,8 @@ meta_cursor_renderer_native_realize_cursor_from_wl_buffer (MetaCursorRenderer *r
           return;
         }
 
-      set_pending_cursor_sprite_gbm_bo (cursor_sprite, bo);
+      set_pending_cursor_sprite_gbm_bo (cursor_sprite,
+                                        cursor_bo_new (native, bo));
     }
 }
 #endif
@@ -660,6 +898,9 @@ meta_cursor_renderer_native_init (MetaCursorRendererNative *native)
   CoglContext *ctx = clutter_backend_get_cogl_context (clutter_get_default_backend ());
   MetaMonitorManager *monitors;
 
+  priv->bo_cache = g_hash_table_new (cursor_bo_hash, cursor_bo_equal);
+  priv->crtc_states = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
   monitors = meta_monitor_manager_get ();
   g_signal_connect_object (monitors, "monitors-changed",
                            G_CALLBACK (on_monitors_changed), native, 0);
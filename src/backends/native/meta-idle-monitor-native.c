@@ -35,6 +35,16 @@ struct _MetaIdleMonitorNative
   MetaIdleMonitor parent;
 
   guint64 last_event_time;
+
+  /* Watches sorted by timeout, user active watches (with a timeout of 0)
+   * first. A single source is armed for the nearest idle watch that has
+   * not fired since the last reset. */
+  GSequence *sorted_watches;
+  GSource *timeout_source;
+
+  /* Incremented on every reset; a watch has fired during the current
+   * idle period if its fired_serial matches */
+  guint32 reset_serial;
 };
 
 struct _MetaIdleMonitorNativeClass
@@ -45,7 +55,8 @@ struct _MetaIdleMonitorNativeClass
 typedef struct {
   MetaIdleMonitorWatch base;
 
-  GSource *timeout_source;
+  GSequenceIter *iter;
+  guint32 fired_serial;
 } MetaIdleMonitorWatchNative;
 
 G_DEFINE_TYPE (MetaIdleMonitorNative, meta_idle_monitor_native, META_TYPE_IDLE_MONITOR)
@@ -66,16 +77,120 @@ get_next_watch_serial (void)
   return serial;
 }
 
+static gint
+compare_watch_timeouts (gconstpointer a,
+                        gconstpointer b,
+                        gpointer      user_data)
+{
+  const MetaIdleMonitorWatch *watch_a = a;
+  const MetaIdleMonitorWatch *watch_b = b;
+
+  if (watch_a->timeout_msec < watch_b->timeout_msec)
+    return -1;
+  else if (watch_a->timeout_msec > watch_b->timeout_msec)
+    return 1;
+  else
+    return 0;
+}
+
+static gboolean
+has_fired (MetaIdleMonitorNative      *monitor_native,
+           MetaIdleMonitorWatchNative *watch_native)
+{
+  return watch_native->fired_serial == monitor_native->reset_serial;
+}
+
+/* Arms the timeout source for the first idle watch that hasn't fired yet */
+static void
+update_timeout (MetaIdleMonitorNative *monitor_native)
+{
+  GSequenceIter *iter;
+
+  if (!monitor_native->timeout_source)
+    return;
+
+  for (iter = g_sequence_get_begin_iter (monitor_native->sorted_watches);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    {
+      MetaIdleMonitorWatchNative *watch_native = g_sequence_get (iter);
+
+      if (watch_native->base.timeout_msec == 0 ||
+          has_fired (monitor_native, watch_native))
+        continue;
+
+      g_source_set_ready_time (monitor_native->timeout_source,
+                               monitor_native->last_event_time +
+                               watch_native->base.timeout_msec * 1000);
+      return;
+    }
+
+  g_source_set_ready_time (monitor_native->timeout_source, -1);
+}
+
+/* Fires the watches with the given ids that are still around; callbacks
+ * may remove or add any watch */
+static void
+fire_watches (MetaIdleMonitor *monitor,
+              GList           *watch_ids)
+{
+  GList *node;
+
+  for (node = watch_ids; node != NULL; node = node->next)
+    {
+      MetaIdleMonitorWatch *watch;
+
+      watch = g_hash_table_lookup (monitor->watches, node->data);
+      if (!watch)
+        continue;
+
+      _meta_idle_monitor_watch_fire (watch);
+    }
+}
+
 static gboolean
 native_dispatch_timeout (GSource     *source,
                          GSourceFunc  callback,
                          gpointer     user_data)
 {
-  MetaIdleMonitorWatchNative *watch_native = user_data;
-  MetaIdleMonitorWatch *watch = (MetaIdleMonitorWatch *) watch_native;
+  MetaIdleMonitorNative *monitor_native = user_data;
+  MetaIdleMonitor *monitor = META_IDLE_MONITOR (monitor_native);
+  GSequenceIter *iter;
+  GList *watch_ids = NULL;
+  gint64 now;
+
+  g_object_ref (monitor);
+
+  now = g_source_get_time (source);
+
+  for (iter = g_sequence_get_begin_iter (monitor_native->sorted_watches);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    {
+      MetaIdleMonitorWatchNative *watch_native = g_sequence_get (iter);
+      MetaIdleMonitorWatch *watch = (MetaIdleMonitorWatch *) watch_native;
+
+      if (watch->timeout_msec == 0)
+        continue;
+
+      if (monitor_native->last_event_time + watch->timeout_msec * 1000 > now)
+        break;
+
+      if (has_fired (monitor_native, watch_native))
+        continue;
+
+      watch_native->fired_serial = monitor_native->reset_serial;
+      watch_ids = g_list_prepend (watch_ids, GUINT_TO_POINTER (watch->id));
+    }
+
+  watch_ids = g_list_reverse (watch_ids);
+  fire_watches (monitor, watch_ids);
+  g_list_free (watch_ids);
+
+  update_timeout (monitor_native);
+
+  g_object_unref (monitor);
 
-  _meta_idle_monitor_watch_fire (watch);
-  g_source_set_ready_time (watch_native->timeout_source, -1);
   return TRUE;
 }
 
@@ -92,6 +207,7 @@ free_watch (gpointer data)
   MetaIdleMonitorWatchNative *watch_native = data;
   MetaIdleMonitorWatch *watch = (MetaIdleMonitorWatch *) watch_native;
   MetaIdleMonitor *monitor = watch->monitor;
+  MetaIdleMonitorNative *monitor_native = META_IDLE_MONITOR_NATIVE (monitor);
 
   g_object_ref (monitor);
 
@@ -104,8 +220,8 @@ free_watch (gpointer data)
   if (watch->notify != NULL)
     watch->notify (watch->user_data);
 
-  if (watch_native->timeout_source != NULL)
-    g_source_destroy (watch_native->timeout_source);
+  g_sequence_remove (watch_native->iter);
+  update_timeout (monitor_native);
 
   g_object_unref (monitor);
   g_slice_free (MetaIdleMonitorWatchNative, watch_native);
@@ -132,26 +248,51 @@ meta_idle_monitor_native_make_watch (MetaIdleMonitor           *monitor,
   watch->notify = notify;
   watch->timeout_msec = timeout_msec;
 
+  watch_native->iter = g_sequence_insert_sorted (monitor_native->sorted_watches,
+                                                 watch_native,
+                                                 compare_watch_timeouts,
+                                                 NULL);
+
   if (timeout_msec != 0)
-    {
-      GSource *source = g_source_new (&native_source_funcs, sizeof (GSource));
+    update_timeout (monitor_native);
+
+  return watch;
+}
+
+static void
+meta_idle_monitor_native_dispose (GObject *object)
+{
+  MetaIdleMonitorNative *monitor_native = META_IDLE_MONITOR_NATIVE (object);
 
-      g_source_set_callback (source, NULL, watch, NULL);
-      g_source_set_ready_time (source, monitor_native->last_event_time + timeout_msec * 1000);
-      g_source_attach (source, NULL);
-      g_source_unref (source);
+  /* The watches are freed when chaining up, and need the sorted list */
+  G_OBJECT_CLASS (meta_idle_monitor_native_parent_class)->dispose (object);
 
-      watch_native->timeout_source = source;
+  if (monitor_native->timeout_source)
+    {
+      g_source_destroy (monitor_native->timeout_source);
+      g_clear_pointer (&monitor_native->timeout_source, g_source_unref);
     }
+}
 
-  return watch;
+static void
+meta_idle_monitor_native_finalize (GObject *object)
+{
+  MetaIdleMonitorNative *monitor_native = META_IDLE_MONITOR_NATIVE (object);
+
+  g_sequence_free (monitor_native->sorted_watches);
+
+  G_OBJECT_CLASS (meta_idle_monitor_native_parent_class)->finalize (object);
 }
 
 static void
 meta_idle_monitor_native_class_init (MetaIdleMonitorNativeClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   MetaIdleMonitorClass *idle_monitor_class = META_IDLE_MONITOR_CLASS (klass);
 
+  object_class->dispose = meta_idle_monitor_native_dispose;
+  object_class->finalize = meta_idle_monitor_native_finalize;
+
   idle_monitor_class->get_idletime = meta_idle_monitor_native_get_idletime;
   idle_monitor_class->make_watch = meta_idle_monitor_native_make_watch;
 }
@@ -160,40 +301,54 @@ static void
 meta_idle_monitor_native_init (MetaIdleMonitorNative *monitor_native)
 {
   MetaIdleMonitor *monitor = META_IDLE_MONITOR (monitor_native);
+  GSource *source;
 
   monitor->watches = g_hash_table_new_full (NULL, NULL, NULL, free_watch);
+
+  monitor_native->sorted_watches = g_sequence_new (NULL);
+  monitor_native->reset_serial = 1;
+
+  source = g_source_new (&native_source_funcs, sizeof (GSource));
+  g_source_set_callback (source, NULL, monitor_native, NULL);
+  g_source_set_name (source, "[mutter] idle monitor");
+  g_source_set_ready_time (source, -1);
+  g_source_attach (source, NULL);
+  monitor_native->timeout_source = source;
 }
 
 void
 meta_idle_monitor_native_reset_idletime (MetaIdleMonitor *monitor)
 {
   MetaIdleMonitorNative *monitor_native = META_IDLE_MONITOR_NATIVE (monitor);
-  GList *node, *watch_ids;
+  GSequenceIter *iter;
+  GList *watch_ids = NULL;
 
   monitor_native->last_event_time = g_get_monotonic_time ();
+  monitor_native->reset_serial++;
 
-  watch_ids = g_hash_table_get_keys (monitor->watches);
+  /* User active watches sort first */
+  for (iter = g_sequence_get_begin_iter (monitor_native->sorted_watches);
+       !g_sequence_iter_is_end (iter);
+       iter = g_sequence_iter_next (iter))
+    {
+      MetaIdleMonitorWatch *watch = g_sequence_get (iter);
 
-  for (node = watch_ids; node != NULL; node = node->next)
+      if (watch->timeout_msec != 0)
+        break;
+
+      watch_ids = g_list_prepend (watch_ids, GUINT_TO_POINTER (watch->id));
+    }
+
+  if (watch_ids)
     {
-      guint watch_id = GPOINTER_TO_UINT (node->data);
-      MetaIdleMonitorWatchNative *watch;
+      g_object_ref (monitor);
 
-      watch = g_hash_table_lookup (monitor->watches, GUINT_TO_POINTER (watch_id));
-      if (!watch)
-        continue;
+      watch_ids = g_list_reverse (watch_ids);
+      fire_watches (monitor, watch_ids);
+      g_list_free (watch_ids);
 
-      if (watch->base.timeout_msec == 0)
-        {
-          _meta_idle_monitor_watch_fire ((MetaIdleMonitorWatch *) watch);
-        }
-      else
-        {
-          g_source_set_ready_time (watch->timeout_source,
-                                   monitor_native->last_event_time +
-                                   watch->base.timeout_msec * 1000);
-        }
+      g_object_unref (monitor);
     }
 
-  g_list_free (watch_ids);
+  update_timeout (monitor_native);
 }
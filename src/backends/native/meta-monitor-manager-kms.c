@@ -56,6 +56,7 @@ typedef struct {
   uint32_t enc_clone_mask;
 
   uint32_t dpms_prop_id;
+  uint32_t crtc_id_prop_id;
   uint32_t edid_blob_id;
   uint32_t tile_blob_id;
 
@@ -68,21 +69,70 @@ typedef struct {
   uint32_t underscan_prop_id;
   uint32_t underscan_hborder_prop_id;
   uint32_t underscan_vborder_prop_id;
+  uint32_t active_prop_id;
+  uint32_t mode_id_prop_id;
   uint32_t primary_plane_id;
   uint32_t rotation_prop_id;
   uint32_t rotation_map[ALL_TRANSFORMS];
 } MetaCRTCKms;
 
+/* Plane properties set by the atomic configuration test */
+typedef enum {
+  PLANE_PROP_FB_ID,
+  PLANE_PROP_CRTC_ID,
+  PLANE_PROP_SRC_X,
+  PLANE_PROP_SRC_Y,
+  PLANE_PROP_SRC_W,
+  PLANE_PROP_SRC_H,
+  PLANE_PROP_CRTC_X,
+  PLANE_PROP_CRTC_Y,
+  PLANE_PROP_CRTC_W,
+  PLANE_PROP_CRTC_H,
+  N_PLANE_PROPS
+} MetaPlaneProp;
+
+static const char *plane_prop_names[N_PLANE_PROPS] = {
+  "FB_ID",
+  "CRTC_ID",
+  "SRC_X",
+  "SRC_Y",
+  "SRC_W",
+  "SRC_H",
+  "CRTC_X",
+  "CRTC_Y",
+  "CRTC_W",
+  "CRTC_H",
+};
+
+typedef struct {
+  uint32_t plane_id;
+  uint32_t prop_ids[N_PLANE_PROPS];
+} MetaPlaneKms;
+
 struct _MetaMonitorManagerKms
 {
   MetaMonitorManager parent_instance;
 
   int fd;
+  gboolean atomic_test;
 
   drmModeConnector **connectors;
   unsigned int       n_connectors;
 
+  /* Only read when the atomic configuration test is enabled */
+  MetaPlaneKms *planes;
+  unsigned int  n_planes;
+
+  /* Connectors probed while handling a hotplug event, for the following
+   * read_current() to use instead of probing them again */
+  drmModeConnector **probed_connectors;
+  unsigned int       n_probed_connectors;
+
+  /* EDID contents by connector ID, as of the last read_current() */
+  GHashTable *connector_edids;
+
   GUdevClient *udev;
+  guint hotplug_idle_id;
 
   GSettings *desktop_settings;
 };
@@ -95,14 +145,53 @@ struct _MetaMonitorManagerKmsClass
 G_DEFINE_TYPE (MetaMonitorManagerKms, meta_monitor_manager_kms, META_TYPE_MONITOR_MANAGER);
 
 static void
-free_resources (MetaMonitorManagerKms *manager_kms)
+free_connectors (drmModeConnector **connectors,
+                 unsigned int       n_connectors)
 {
   unsigned i;
 
-  for (i = 0; i < manager_kms->n_connectors; i++)
-    drmModeFreeConnector (manager_kms->connectors[i]);
+  for (i = 0; i < n_connectors; i++)
+    if (connectors[i])
+      drmModeFreeConnector (connectors[i]);
+
+  g_free (connectors);
+}
+
+static void
+free_resources (MetaMonitorManagerKms *manager_kms)
+{
+  free_connectors (manager_kms->connectors, manager_kms->n_connectors);
 
-  g_free (manager_kms->connectors);
+  g_free (manager_kms->planes);
+  manager_kms->planes = NULL;
+  manager_kms->n_planes = 0;
+}
+
+static void
+free_probed_connectors (MetaMonitorManagerKms *manager_kms)
+{
+  free_connectors (manager_kms->probed_connectors,
+                   manager_kms->n_probed_connectors);
+  manager_kms->probed_connectors = NULL;
+  manager_kms->n_probed_connectors = 0;
+}
+
+static drmModeConnector *
+get_connector (MetaMonitorManagerKms *manager_kms,
+               unsigned int           idx,
+               uint32_t               connector_id)
+{
+  if (idx < manager_kms->n_probed_connectors &&
+      manager_kms->probed_connectors[idx] &&
+      manager_kms->probed_connectors[idx]->connector_id == connector_id)
+    {
+      drmModeConnector *connector = manager_kms->probed_connectors[idx];
+
+      manager_kms->probed_connectors[idx] = NULL;
+      return connector;
+    }
+
+  return drmModeGetConnector (manager_kms->fd, connector_id);
 }
 
 static int
@@ -219,6 +308,8 @@ find_connector_properties (MetaMonitorManagerKms *manager_kms,
 
       if ((prop->flags & DRM_MODE_PROP_ENUM) && strcmp (prop->name, "DPMS") == 0)
         output_kms->dpms_prop_id = prop->prop_id;
+      else if (strcmp (prop->name, "CRTC_ID") == 0)
+        output_kms->crtc_id_prop_id = prop->prop_id;
       else if ((prop->flags & DRM_MODE_PROP_BLOB) && strcmp (prop->name, "EDID") == 0)
         output_kms->edid_blob_id = output_kms->connector->prop_values[i];
       else if ((prop->flags & DRM_MODE_PROP_BLOB) &&
@@ -264,9 +355,83 @@ find_crtc_properties (MetaMonitorManagerKms *manager_kms,
         crtc_kms->underscan_hborder_prop_id = prop->prop_id;
       else if ((prop->flags & DRM_MODE_PROP_RANGE) && strcmp (prop->name, "underscan vborder") == 0)
         crtc_kms->underscan_vborder_prop_id = prop->prop_id;
+      else if (strcmp (prop->name, "ACTIVE") == 0)
+        crtc_kms->active_prop_id = prop->prop_id;
+      else if (strcmp (prop->name, "MODE_ID") == 0)
+        crtc_kms->mode_id_prop_id = prop->prop_id;
 
       drmModeFreeProperty (prop);
     }
+
+  drmModeFreeObjectProperties (props);
+}
+
+static void
+find_plane_properties (MetaMonitorManagerKms *manager_kms,
+                       MetaPlaneKms          *plane_kms)
+{
+  drmModeObjectPropertiesPtr props;
+  uint32_t i;
+  int j;
+
+  props = drmModeObjectGetProperties (manager_kms->fd, plane_kms->plane_id,
+                                      DRM_MODE_OBJECT_PLANE);
+  if (!props)
+    return;
+
+  for (i = 0; i < props->count_props; i++)
+    {
+      drmModePropertyPtr prop = drmModeGetProperty (manager_kms->fd, props->props[i]);
+      if (!prop)
+        continue;
+
+      for (j = 0; j < N_PLANE_PROPS; j++)
+        {
+          if (strcmp (prop->name, plane_prop_names[j]) == 0)
+            {
+              plane_kms->prop_ids[j] = prop->prop_id;
+              break;
+            }
+        }
+
+      drmModeFreeProperty (prop);
+    }
+
+  drmModeFreeObjectProperties (props);
+}
+
+static void
+read_planes (MetaMonitorManagerKms *manager_kms)
+{
+  drmModePlaneRes *planes;
+  uint32_t i;
+
+  planes = drmModeGetPlaneResources (manager_kms->fd);
+  if (!planes)
+    return;
+
+  manager_kms->n_planes = planes->count_planes;
+  manager_kms->planes = g_new0 (MetaPlaneKms, manager_kms->n_planes);
+  for (i = 0; i < planes->count_planes; i++)
+    {
+      manager_kms->planes[i].plane_id = planes->planes[i];
+      find_plane_properties (manager_kms, &manager_kms->planes[i]);
+    }
+
+  drmModeFreePlaneResources (planes);
+}
+
+static MetaPlaneKms *
+find_plane (MetaMonitorManagerKms *manager_kms,
+            uint32_t               plane_id)
+{
+  unsigned int i;
+
+  for (i = 0; i < manager_kms->n_planes; i++)
+    if (manager_kms->planes[i].plane_id == plane_id)
+      return &manager_kms->planes[i];
+
+  return NULL;
 }
 
 static GBytes *
@@ -596,6 +761,7 @@ meta_monitor_manager_kms_read_current (MetaMonitorManager *manager)
      users are done with them after we emit monitors-changed, and thus
      are freed by the platform-independent layer. */
   free_resources (manager_kms);
+  g_hash_table_remove_all (manager_kms->connector_edids);
 
   manager_kms->n_connectors = resources->count_connectors;
   manager_kms->connectors = g_new (drmModeConnector *, manager_kms->n_connectors);
@@ -603,7 +769,7 @@ meta_monitor_manager_kms_read_current (MetaMonitorManager *manager)
     {
       drmModeConnector *connector;
 
-      connector = drmModeGetConnector (manager_kms->fd, resources->connectors[i]);
+      connector = get_connector (manager_kms, i, resources->connectors[i]);
       manager_kms->connectors[i] = connector;
 
       if (connector && connector->connection == DRM_MODE_CONNECTED)
@@ -614,6 +780,11 @@ meta_monitor_manager_kms_read_current (MetaMonitorManager *manager)
         }
     }
 
+  free_probed_connectors (manager_kms);
+
+  if (manager_kms->atomic_test)
+    read_planes (manager_kms);
+
   encoders = g_new (drmModeEncoder *, resources->count_encoders);
   for (i = 0; i < (unsigned)resources->count_encoders; i++)
     encoders[i] = drmModeGetEncoder (manager_kms->fd, resources->encoders[i]);
@@ -830,6 +1001,10 @@ meta_monitor_manager_kms_read_current (MetaMonitorManager *manager)
           
           edid = read_output_edid (manager_kms, meta_output);
           meta_output_parse_edid (meta_output, edid);
+          if (edid)
+            g_hash_table_insert (manager_kms->connector_edids,
+                                 GUINT_TO_POINTER (connector->connector_id),
+                                 g_bytes_ref (edid));
           g_bytes_unref (edid);
 
           /* MetaConnectorType matches DRM's connector types */
@@ -1052,12 +1227,322 @@ set_underscan (MetaMonitorManagerKms *manager_kms,
     }
 }
 
+/* Property IDs are looked up once, when reading the current state;
+ * a missing one means the driver can't take part in the test. */
+static gboolean
+add_atomic_prop (drmModeAtomicReq *req,
+                 uint32_t          object_id,
+                 uint32_t          prop_id,
+                 const char       *name,
+                 uint64_t          value)
+{
+  if (prop_id == 0)
+    {
+      meta_verbose ("KMS object %u has no %s property\n", object_id, name);
+      return FALSE;
+    }
+
+  return drmModeAtomicAddProperty (req, object_id, prop_id, value) >= 0;
+}
+
+static gboolean
+add_atomic_plane_prop (drmModeAtomicReq *req,
+                       MetaPlaneKms     *plane_kms,
+                       MetaPlaneProp     prop,
+                       uint64_t          value)
+{
+  return add_atomic_prop (req, plane_kms->plane_id, plane_kms->prop_ids[prop],
+                          plane_prop_names[prop], value);
+}
+
+typedef struct {
+  uint32_t handle;
+  uint32_t fb_id;
+} TestFb;
+
+static gboolean
+test_fb_create (int       fd,
+                uint32_t  width,
+                uint32_t  height,
+                TestFb   *test_fb)
+{
+  struct drm_mode_create_dumb create_dumb = { 0 };
+
+  create_dumb.width = width;
+  create_dumb.height = height;
+  create_dumb.bpp = 32;
+
+  if (drmIoctl (fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb) != 0)
+    return FALSE;
+
+  test_fb->handle = create_dumb.handle;
+
+  if (drmModeAddFB (fd, width, height, 24, 32, create_dumb.pitch,
+                    create_dumb.handle, &test_fb->fb_id) != 0)
+    {
+      struct drm_mode_destroy_dumb destroy_dumb = { create_dumb.handle };
+
+      drmIoctl (fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
+test_fb_destroy (int     fd,
+                 TestFb *test_fb)
+{
+  struct drm_mode_destroy_dumb destroy_dumb = { test_fb->handle };
+
+  drmModeRmFB (fd, test_fb->fb_id);
+  drmIoctl (fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
+}
+
+/* plane_crtc_ids holds the CRTC each of manager_kms->planes is
+ * currently on, as read at the start of the test. */
+static gboolean
+add_atomic_crtc_off (MetaMonitorManagerKms *manager_kms,
+                     drmModeAtomicReq      *req,
+                     MetaCRTC              *crtc,
+                     const uint32_t        *plane_crtc_ids)
+{
+  MetaCRTCKms *crtc_kms = crtc->driver_private;
+  unsigned int i;
+
+  if (!add_atomic_prop (req, crtc->crtc_id, crtc_kms->active_prop_id, "ACTIVE", 0) ||
+      !add_atomic_prop (req, crtc->crtc_id, crtc_kms->mode_id_prop_id, "MODE_ID", 0))
+    return FALSE;
+
+  /* The primary plane, and any cursor or overlay plane that is still
+   * shown on this CRTC, has to go with it. */
+  for (i = 0; i < manager_kms->n_planes; i++)
+    {
+      MetaPlaneKms *plane_kms = &manager_kms->planes[i];
+
+      if (plane_crtc_ids[i] != crtc->crtc_id)
+        continue;
+
+      if (!add_atomic_plane_prop (req, plane_kms, PLANE_PROP_FB_ID, 0) ||
+          !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_ID, 0))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+add_atomic_crtc_on (MetaMonitorManagerKms *manager_kms,
+                    drmModeAtomicReq      *req,
+                    MetaCRTCInfo          *crtc_info,
+                    uint32_t               mode_blob_id,
+                    uint32_t               fb_id)
+{
+  MetaCRTC *crtc = crtc_info->crtc;
+  MetaCRTCKms *crtc_kms = crtc->driver_private;
+  MetaPlaneKms *plane_kms;
+  uint64_t width = crtc_info->mode->width;
+  uint64_t height = crtc_info->mode->height;
+  unsigned int j;
+
+  plane_kms = find_plane (manager_kms, crtc_kms->primary_plane_id);
+  if (!plane_kms)
+    return FALSE;
+
+  if (!add_atomic_prop (req, crtc->crtc_id, crtc_kms->active_prop_id, "ACTIVE", 1) ||
+      !add_atomic_prop (req, crtc->crtc_id, crtc_kms->mode_id_prop_id, "MODE_ID", mode_blob_id))
+    return FALSE;
+
+  /* Scan out an unrotated buffer of the mode's size; rotation support
+   * is already checked against crtc->all_transforms. */
+  if (!add_atomic_plane_prop (req, plane_kms, PLANE_PROP_FB_ID, fb_id) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_ID, crtc->crtc_id) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_SRC_X, 0) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_SRC_Y, 0) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_SRC_W, width << 16) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_SRC_H, height << 16) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_X, 0) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_Y, 0) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_W, width) ||
+      !add_atomic_plane_prop (req, plane_kms, PLANE_PROP_CRTC_H, height))
+    return FALSE;
+
+  for (j = 0; j < crtc_info->outputs->len; j++)
+    {
+      MetaOutput *output = g_ptr_array_index (crtc_info->outputs, j);
+      MetaOutputKms *output_kms = output->driver_private;
+
+      if (!add_atomic_prop (req, output->winsys_id, output_kms->crtc_id_prop_id,
+                            "CRTC_ID", crtc->crtc_id))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Asks the kernel, through a TEST_ONLY atomic commit, whether the whole
+ * configuration can be driven before Cogl starts applying it CRTC by
+ * CRTC with the legacy API. Cogl owns the real framebuffers, so the
+ * test scans out throwaway dumb buffers of the right size.
+ *
+ * Returns FALSE only if the kernel rejected the configuration; if the
+ * driver can't be asked (no atomic support, missing properties), the
+ * configuration is assumed to be fine, as before.
+ */
+static gboolean
+test_configuration (MetaMonitorManagerKms *manager_kms,
+                    MetaCRTCInfo         **crtcs,
+                    unsigned int           n_crtcs,
+                    GError               **error)
+{
+  MetaMonitorManager *manager = META_MONITOR_MANAGER (manager_kms);
+  int fd = manager_kms->fd;
+  drmModeAtomicReq *req;
+  uint32_t *plane_crtc_ids;
+  GHashTable *enabled_crtcs, *enabled_outputs;
+  GArray *blob_ids, *test_fbs;
+  gboolean testable = TRUE;
+  gboolean ok = TRUE;
+  unsigned int i;
+
+  if (!manager_kms->atomic_test || manager_kms->n_planes == 0)
+    return TRUE;
+
+  /* Cursors and overlays move between CRTCs behind our back, so which
+   * plane is on which CRTC is read once per test rather than cached. */
+  plane_crtc_ids = g_new0 (uint32_t, manager_kms->n_planes);
+  for (i = 0; i < manager_kms->n_planes; i++)
+    {
+      drmModePlane *drm_plane;
+
+      drm_plane = drmModeGetPlane (fd, manager_kms->planes[i].plane_id);
+      if (!drm_plane)
+        continue;
+
+      plane_crtc_ids[i] = drm_plane->crtc_id;
+      drmModeFreePlane (drm_plane);
+    }
+
+  req = drmModeAtomicAlloc ();
+  enabled_crtcs = g_hash_table_new (NULL, NULL);
+  enabled_outputs = g_hash_table_new (NULL, NULL);
+  blob_ids = g_array_new (FALSE, FALSE, sizeof (uint32_t));
+  test_fbs = g_array_new (FALSE, FALSE, sizeof (TestFb));
+
+  for (i = 0; i < n_crtcs && testable; i++)
+    {
+      MetaCRTCInfo *crtc_info = crtcs[i];
+      MetaCRTC *crtc = crtc_info->crtc;
+      MetaCRTCKms *crtc_kms = crtc->driver_private;
+      unsigned int j;
+
+      g_hash_table_add (enabled_crtcs, crtc);
+
+      if (crtc_info->mode == NULL)
+        {
+          testable = add_atomic_crtc_off (manager_kms, req, crtc, plane_crtc_ids);
+        }
+      else
+        {
+          uint32_t blob_id;
+          TestFb test_fb;
+
+          if (crtc_kms->primary_plane_id == 0)
+            {
+              testable = FALSE;
+              break;
+            }
+
+          if (drmModeCreatePropertyBlob (fd, crtc_info->mode->driver_private,
+                                         sizeof (drmModeModeInfo), &blob_id) != 0)
+            {
+              testable = FALSE;
+              break;
+            }
+          g_array_append_val (blob_ids, blob_id);
+
+          if (!test_fb_create (fd, crtc_info->mode->width, crtc_info->mode->height,
+                               &test_fb))
+            {
+              testable = FALSE;
+              break;
+            }
+          g_array_append_val (test_fbs, test_fb);
+
+          testable = add_atomic_crtc_on (manager_kms, req, crtc_info,
+                                         blob_id, test_fb.fb_id);
+
+          for (j = 0; j < crtc_info->outputs->len; j++)
+            g_hash_table_add (enabled_outputs,
+                              g_ptr_array_index (crtc_info->outputs, j));
+        }
+    }
+
+  /* Like apply_configuration(), turn off whatever isn't mentioned */
+  for (i = 0; i < manager->n_crtcs && testable; i++)
+    {
+      MetaCRTC *crtc = &manager->crtcs[i];
+
+      if (!g_hash_table_contains (enabled_crtcs, crtc))
+        testable = add_atomic_crtc_off (manager_kms, req, crtc, plane_crtc_ids);
+    }
+
+  for (i = 0; i < manager->n_outputs && testable; i++)
+    {
+      MetaOutput *output = &manager->outputs[i];
+
+      MetaOutputKms *output_kms = output->driver_private;
+
+      if (!g_hash_table_contains (enabled_outputs, output))
+        testable = add_atomic_prop (req, output->winsys_id,
+                                    output_kms->crtc_id_prop_id, "CRTC_ID", 0);
+    }
+
+  if (testable)
+    {
+      gint64 start_time = g_get_monotonic_time ();
+
+      if (drmModeAtomicCommit (fd, req,
+                               DRM_MODE_ATOMIC_TEST_ONLY |
+                               DRM_MODE_ATOMIC_ALLOW_MODESET,
+                               NULL) != 0)
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                       "Display configuration rejected by the kernel: %s",
+                       g_strerror (errno));
+          ok = FALSE;
+        }
+
+      meta_verbose ("Atomic test of display configuration took %" G_GINT64_FORMAT " us\n",
+                    g_get_monotonic_time () - start_time);
+    }
+  else
+    {
+      meta_verbose ("Can't test display configuration atomically, applying it untested\n");
+    }
+
+  for (i = 0; i < test_fbs->len; i++)
+    test_fb_destroy (fd, &g_array_index (test_fbs, TestFb, i));
+  for (i = 0; i < blob_ids->len; i++)
+    drmModeDestroyPropertyBlob (fd, g_array_index (blob_ids, uint32_t, i));
+
+  g_array_free (test_fbs, TRUE);
+  g_array_free (blob_ids, TRUE);
+  g_hash_table_destroy (enabled_outputs);
+  g_hash_table_destroy (enabled_crtcs);
+  drmModeAtomicFree (req);
+  g_free (plane_crtc_ids);
+
+  return ok;
+}
+
+static gboolean
 meta_monitor_manager_kms_apply_configuration (MetaMonitorManager *manager,
                                               MetaCRTCInfo       **crtcs,
                                               unsigned int         n_crtcs,
                                               MetaOutputInfo     **outputs,
-                                              unsigned int         n_outputs)
+                                              unsigned int         n_outputs,
+                                              GError             **error)
 {
   MetaMonitorManagerKms *manager_kms = META_MONITOR_MANAGER_KMS (manager);
   ClutterBackend *backend;
@@ -1067,7 +1552,11 @@ meta_monitor_manager_kms_apply_configuration (MetaMonitorManager *manager,
   GPtrArray *cogl_crtcs;
   int screen_width, screen_height;
   gboolean ok;
-  GError *error;
+
+  /* Reject configurations the hardware can't drive before touching
+   * anything, instead of finding out halfway through */
+  if (!test_configuration (manager_kms, crtcs, n_crtcs, error))
+    return FALSE;
 
   cogl_crtcs = g_ptr_array_new_full (manager->n_crtcs, (GDestroyNotify)crtc_free);
   screen_width = 0; screen_height = 0;
@@ -1194,17 +1683,12 @@ meta_monitor_manager_kms_apply_configuration (MetaMonitorManager *manager,
   cogl_context = clutter_backend_get_cogl_context (backend);
   cogl_display = cogl_context_get_display (cogl_context);
 
-  error = NULL;
   ok = cogl_kms_display_set_layout (cogl_display, screen_width, screen_height,
-                                    (CoglKmsCrtc**)cogl_crtcs->pdata, cogl_crtcs->len, &error);
+                                    (CoglKmsCrtc**)cogl_crtcs->pdata, cogl_crtcs->len, error);
   g_ptr_array_unref (cogl_crtcs);
 
   if (!ok)
-    {
-      meta_warning ("Applying display configuration failed: %s\n", error->message);
-      g_error_free (error);
-      return;
-    }
+    return FALSE;
 
   for (i = 0; i < n_outputs; i++)
     {
@@ -1237,6 +1721,8 @@ meta_monitor_manager_kms_apply_configuration (MetaMonitorManager *manager,
   manager->screen_height = screen_height;
 
   meta_monitor_manager_rebuild_derived (manager);
+
+  return TRUE;
 }
 
 static void
@@ -1275,6 +1761,182 @@ meta_monitor_manager_kms_set_crtc_gamma (MetaMonitorManager *manager,
   drmModeCrtcSetGamma (manager_kms->fd, crtc->crtc_id, size, red, green, blue);
 }
 
+/* Connector properties that change while the same monitor stays
+ * plugged in: we set DPMS and CRTC_ID ourselves, and the driver updates
+ * link-status when it retrains the link. */
+static const char * const volatile_connector_props[] = {
+  "DPMS",
+  "CRTC_ID",
+  "link-status",
+};
+
+static gboolean
+is_volatile_connector_prop (const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < G_N_ELEMENTS (volatile_connector_props); i++)
+    if (strcmp (name, volatile_connector_props[i]) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+static gboolean
+connector_edid_equal (MetaMonitorManagerKms *manager_kms,
+                      uint32_t               connector_id,
+                      uint32_t               edid_blob_id)
+{
+  GBytes *old_edid;
+  drmModePropertyBlobPtr edid_blob;
+  gboolean equal;
+
+  old_edid = g_hash_table_lookup (manager_kms->connector_edids,
+                                  GUINT_TO_POINTER (connector_id));
+
+  if (edid_blob_id == 0)
+    return old_edid == NULL;
+  if (old_edid == NULL)
+    return FALSE;
+
+  edid_blob = drmModeGetPropertyBlob (manager_kms->fd, edid_blob_id);
+  if (!edid_blob)
+    return FALSE;
+
+  equal = (edid_blob->length == g_bytes_get_size (old_edid) &&
+           memcmp (edid_blob->data, g_bytes_get_data (old_edid, NULL),
+                   edid_blob->length) == 0);
+
+  drmModeFreePropertyBlob (edid_blob);
+
+  return equal;
+}
+
+static gboolean
+connector_prop_values_equal (MetaMonitorManagerKms *manager_kms,
+                             drmModeConnector      *probed,
+                             drmModeConnector      *current)
+{
+  int i;
+
+  for (i = 0; i < probed->count_props; i++)
+    {
+      drmModePropertyPtr prop;
+      gboolean equal;
+
+      if (probed->prop_values[i] == current->prop_values[i])
+        continue;
+
+      prop = drmModeGetProperty (manager_kms->fd, probed->props[i]);
+      if (!prop)
+        return FALSE;
+
+      /* The kernel replaces the EDID blob on every probe, so its ID
+       * changes even when the monitor doesn't; the old blob is usually
+       * gone by now, hence comparing against the contents we kept. */
+      if ((prop->flags & DRM_MODE_PROP_BLOB) && strcmp (prop->name, "EDID") == 0)
+        equal = connector_edid_equal (manager_kms, probed->connector_id,
+                                      probed->prop_values[i]);
+      else
+        equal = is_volatile_connector_prop (prop->name);
+
+      drmModeFreeProperty (prop);
+
+      if (!equal)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+connector_equal (MetaMonitorManagerKms *manager_kms,
+                 drmModeConnector      *probed,
+                 drmModeConnector      *current)
+{
+  if (probed == NULL || current == NULL)
+    return probed == current;
+
+  return (probed->connector_id == current->connector_id &&
+          probed->connection == current->connection &&
+          probed->mmWidth == current->mmWidth &&
+          probed->mmHeight == current->mmHeight &&
+          probed->encoder_id == current->encoder_id &&
+          probed->count_modes == current->count_modes &&
+          probed->count_props == current->count_props &&
+          probed->count_encoders == current->count_encoders &&
+          memcmp (probed->modes, current->modes,
+                  probed->count_modes * sizeof (drmModeModeInfo)) == 0 &&
+          memcmp (probed->props, current->props,
+                  probed->count_props * sizeof (uint32_t)) == 0 &&
+          memcmp (probed->encoders, current->encoders,
+                  probed->count_encoders * sizeof (uint32_t)) == 0 &&
+          connector_prop_values_equal (manager_kms, probed, current));
+}
+
+/* Probes the connectors and compares them with what we last read.
+ * Returns TRUE if something changed; the probed connectors are then
+ * kept for read_current() so it doesn't have to probe them again. */
+static gboolean
+probe_connectors_changed (MetaMonitorManagerKms *manager_kms)
+{
+  drmModeRes *resources;
+  drmModeConnector **connectors;
+  unsigned int n_connectors, i;
+  gboolean changed;
+
+  resources = drmModeGetResources (manager_kms->fd);
+  if (!resources)
+    return TRUE;
+
+  n_connectors = resources->count_connectors;
+  connectors = g_new0 (drmModeConnector *, n_connectors);
+  for (i = 0; i < n_connectors; i++)
+    connectors[i] = drmModeGetConnector (manager_kms->fd, resources->connectors[i]);
+
+  drmModeFreeResources (resources);
+
+  changed = n_connectors != manager_kms->n_connectors;
+  for (i = 0; i < n_connectors && !changed; i++)
+    changed = !connector_equal (manager_kms,
+                                connectors[i], manager_kms->connectors[i]);
+
+  free_probed_connectors (manager_kms);
+
+  if (changed)
+    {
+      manager_kms->probed_connectors = connectors;
+      manager_kms->n_probed_connectors = n_connectors;
+    }
+  else
+    {
+      free_connectors (connectors, n_connectors);
+    }
+
+  return changed;
+}
+
+static gboolean
+hotplug_idle_cb (gpointer user_data)
+{
+  MetaMonitorManagerKms *manager_kms = META_MONITOR_MANAGER_KMS (user_data);
+  MetaMonitorManager *manager = META_MONITOR_MANAGER (manager_kms);
+
+  manager_kms->hotplug_idle_id = 0;
+
+  if (!probe_connectors_changed (manager_kms))
+    {
+      meta_verbose ("Ignoring hotplug event, connectors are unchanged\n");
+      return G_SOURCE_REMOVE;
+    }
+
+  meta_monitor_manager_read_current_config (manager);
+
+  meta_monitor_manager_on_hotplug (manager);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 on_uevent (GUdevClient *client,
            const char  *action,
@@ -1282,14 +1944,17 @@ on_uevent (GUdevClient *client,
            gpointer     user_data)
 {
   MetaMonitorManagerKms *manager_kms = META_MONITOR_MANAGER_KMS (user_data);
-  MetaMonitorManager *manager = META_MONITOR_MANAGER (manager_kms);
 
   if (!g_udev_device_get_property_as_boolean (device, "HOTPLUG"))
     return;
 
-  meta_monitor_manager_read_current_config (manager);
-
-  meta_monitor_manager_on_hotplug (manager);
+  /* Docks and MST hubs send bursts of these; handle the burst once */
+  if (manager_kms->hotplug_idle_id == 0)
+    {
+      manager_kms->hotplug_idle_id = g_idle_add (hotplug_idle_cb, manager_kms);
+      g_source_set_name_by_id (manager_kms->hotplug_idle_id,
+                               "[mutter] hotplug_idle_cb");
+    }
 }
 
 static void
@@ -1309,6 +1974,15 @@ meta_monitor_manager_kms_init (MetaMonitorManagerKms *manager_kms)
 
   drmSetClientCap (manager_kms->fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
 
+  manager_kms->connector_edids =
+    g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_bytes_unref);
+
+  /* Cogl keeps using the legacy API to modeset; the atomic interface is
+   * only used to validate configurations up front. */
+  if (g_getenv ("MUTTER_DEBUG_DISABLE_ATOMIC_TEST") == NULL)
+    manager_kms->atomic_test =
+      drmSetClientCap (manager_kms->fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0;
+
   const char *subsystems[2] = { "drm", NULL };
   manager_kms->udev = g_udev_client_new (subsystems);
   g_signal_connect (manager_kms->udev, "uevent",
@@ -1322,6 +1996,12 @@ meta_monitor_manager_kms_dispose (GObject *object)
 {
   MetaMonitorManagerKms *manager_kms = META_MONITOR_MANAGER_KMS (object);
 
+  if (manager_kms->hotplug_idle_id)
+    {
+      g_source_remove (manager_kms->hotplug_idle_id);
+      manager_kms->hotplug_idle_id = 0;
+    }
+
   g_clear_object (&manager_kms->udev);
   g_clear_object (&manager_kms->desktop_settings);
 
@@ -1334,6 +2014,8 @@ meta_monitor_manager_kms_finalize (GObject *object)
   MetaMonitorManagerKms *manager_kms = META_MONITOR_MANAGER_KMS (object);
 
   free_resources (manager_kms);
+  free_probed_connectors (manager_kms);
+  g_hash_table_destroy (manager_kms->connector_edids);
 
   G_OBJECT_CLASS (meta_monitor_manager_kms_parent_class)->finalize (object);
 }
@@ -1087,12 +1087,13 @@ output_set_underscanning_xrandr (MetaMonitorManagerXrandr *manager_xrandr,
     }
 }
 
-static void
+static gboolean
 meta_monitor_manager_xrandr_apply_configuration (MetaMonitorManager *manager,
 						 MetaCRTCInfo       **crtcs,
 						 unsigned int         n_crtcs,
 						 MetaOutputInfo     **outputs,
-						 unsigned int         n_outputs)
+						 unsigned int         n_outputs,
+						 GError             **error)
 {
   MetaMonitorManagerXrandr *manager_xrandr = META_MONITOR_MANAGER_XRANDR (manager);
   unsigned i;
@@ -1306,6 +1307,8 @@ meta_monitor_manager_xrandr_apply_configuration (MetaMonitorManager *manager,
 
   XUngrabServer (manager_xrandr->xdisplay);
   XFlush (manager_xrandr->xdisplay);
+
+  return TRUE;
 }
 
 static void
@@ -41,6 +41,7 @@ struct _MetaCompositor
   MetaPluginManager *plugin_mgr;
 
   gboolean frame_has_updated_xsurfaces;
+  gboolean frame_has_subtracted_damage;
   gboolean have_x11_sync_object;
 };
 
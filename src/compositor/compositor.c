@@ -1093,32 +1093,31 @@ meta_pre_paint_func (gpointer data)
 
   if (compositor->frame_has_updated_xsurfaces)
     {
-      /* We need to make sure that any X drawing that happens before
-       * the XDamageSubtract() for each window above is visible to
-       * subsequent GL rendering; the standardized way to do this is
-       * GL_EXT_X11_sync_object. Since this isn't implemented yet in
-       * mesa, we also have a path that relies on the implementation
-       * of the open source drivers.
+      /* We need to make sure that any X drawing we are about to pick
+       * up is visible to subsequent GL rendering; the standardized way
+       * to do this is GL_EXT_X11_sync_object. Since this isn't
+       * implemented yet in mesa, we also have a path that relies on the
+       * implementation of the open source drivers.
        *
        * Anything else, we just hope for the best.
        *
        * Xorg and open source driver specifics:
        *
        * The X server makes sure to flush drawing to the kernel before
-       * sending out damage events, but since we use
-       * DamageReportBoundingBox there may be drawing between the last
-       * damage event and the XDamageSubtract() that needs to be
-       * flushed as well.
-       *
-       * Xorg always makes sure that drawing is flushed to the kernel
-       * before writing events or responses to the client, so any
-       * round trip request at this point is sufficient to flush the
-       * GLX buffers.
+       * sending out damage events. With DamageReportRawRectangles every
+       * piece of drawing we pick up was reported by an event of its own
+       * and is flushed already. Surfaces that fell back to
+       * DamageReportBoundingBox have just done an XDamageSubtract(),
+       * and drawing between their last event and that may not be;
+       * Xorg flushes drawing before writing any reply, so a round trip
+       * takes care of it.
        */
       if (compositor->have_x11_sync_object)
         compositor->have_x11_sync_object = meta_sync_ring_insert_wait ();
-      else
+      else if (compositor->frame_has_subtracted_damage)
         XSync (compositor->display->xdisplay, False);
+
+      compositor->frame_has_subtracted_damage = FALSE;
     }
 
   return TRUE;
@@ -32,6 +32,7 @@
 
 #include <meta/errors.h>
 #include "window-private.h"
+#include "compositor-private.h"
 #include "meta-shaped-texture-private.h"
 #include "meta-cullable.h"
 #include "x11/window-x11.h"
@@ -53,8 +54,20 @@ struct _MetaSurfaceActorX11Private
   guint full_damage_frames_count;
   guint does_full_damage  : 1;
 
-  /* Other state... */
+  /* Damage reported since the last event without the "more" flag */
+  cairo_region_t *pending_damage;
+
+  /* Raw damage events since the last frame, and how many frames in a
+   * row had more than DAMAGE_FLOOD_EVENTS of them; once switched to
+   * bounding boxes, how many frames in a row had no damage at all
+   */
+  guint n_damage_events;
+  guint flooded_frames_count;
+  guint quiet_frames_count;
+  guint coarse_damage : 1;
   guint received_damage : 1;
+
+  /* Other state... */
   guint size_changed : 1;
 
   guint unredirected   : 1;
@@ -63,6 +76,10 @@ typedef struct _MetaSurfaceActorX11Private MetaSurfaceActorX11Private;
 
 G_DEFINE_TYPE_WITH_PRIVATE (MetaSurfaceActorX11, meta_surface_actor_x11, META_TYPE_SURFACE_ACTOR)
 
+#define DAMAGE_FLOOD_EVENTS 256
+#define DAMAGE_FLOOD_FRAMES 5
+#define DAMAGE_QUIET_FRAMES 60
+
 static void
 free_damage (MetaSurfaceActorX11 *self)
 {
@@ -193,8 +210,6 @@ meta_surface_actor_x11_process_damage (MetaSurfaceActor *actor,
   MetaSurfaceActorX11 *self = META_SURFACE_ACTOR_X11 (actor);
   MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
 
-  priv->received_damage = TRUE;
-
   if (meta_window_is_fullscreen (priv->window) && !priv->unredirected && !priv->does_full_damage)
     {
       MetaRectangle window_rect;
@@ -220,23 +235,172 @@ meta_surface_actor_x11_process_damage (MetaSurfaceActor *actor,
   cogl_texture_pixmap_x11_update_area (priv->texture, x, y, width, height);
 }
 
+/* Past this many rectangles, handling them one by one costs more than
+ * repainting their bounding box.
+ */
+#define MAX_DAMAGE_RECTS 32
+
 static void
-meta_surface_actor_x11_pre_paint (MetaSurfaceActor *actor)
+flush_damage (MetaSurfaceActorX11 *self)
+{
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
+  MetaSurfaceActor *actor = META_SURFACE_ACTOR (self);
+  cairo_region_t *region = priv->pending_damage;
+  cairo_rectangle_int_t rect;
+  int i, n_rects;
+
+  if (region == NULL)
+    return;
+
+  priv->pending_damage = NULL;
+
+  n_rects = cairo_region_num_rectangles (region);
+  if (n_rects > MAX_DAMAGE_RECTS)
+    {
+      cairo_region_get_extents (region, &rect);
+      meta_surface_actor_process_damage (actor, rect.x, rect.y,
+                                         rect.width, rect.height);
+    }
+  else
+    {
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (region, i, &rect);
+          meta_surface_actor_process_damage (actor, rect.x, rect.y,
+                                             rect.width, rect.height);
+        }
+    }
+
+  cairo_region_destroy (region);
+}
+
+/* Rectangles that arrive together (the "more" flag) are processed as
+ * one region once the last of them is in.
+ */
+void
+meta_surface_actor_x11_add_damage (MetaSurfaceActorX11 *self,
+                                   XDamageNotifyEvent  *event)
+{
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
+  cairo_rectangle_int_t rect = {
+    .x = event->area.x,
+    .y = event->area.y,
+    .width = event->area.width,
+    .height = event->area.height,
+  };
+
+  if (priv->coarse_damage)
+    {
+      /* The box covers everything drawn since the last subtract */
+      meta_surface_actor_process_damage (META_SURFACE_ACTOR (self),
+                                         rect.x, rect.y,
+                                         rect.width, rect.height);
+      priv->received_damage = TRUE;
+      return;
+    }
+
+  priv->n_damage_events++;
+
+  if (priv->pending_damage == NULL)
+    priv->pending_damage = cairo_region_create_rectangle (&rect);
+  else
+    cairo_region_union_rectangle (priv->pending_damage, &rect);
+
+  if (!event->more)
+    flush_damage (self);
+}
+
+static void create_damage (MetaSurfaceActorX11 *self);
+
+static void
+set_coarse_damage (MetaSurfaceActorX11 *self,
+                   gboolean             coarse_damage)
+{
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
+
+  meta_verbose ("Switching %s to %s damage reports\n",
+                priv->window->desc,
+                coarse_damage ? "bounding box" : "raw rectangle");
+
+  priv->coarse_damage = coarse_damage;
+  priv->received_damage = FALSE;
+  priv->n_damage_events = 0;
+  priv->flooded_frames_count = 0;
+  priv->quiet_frames_count = 0;
+  free_damage (self);
+  create_damage (self);
+
+  /* Reports still on their way for the old Damage object are lost */
+  if (priv->last_width > 0 && priv->last_height > 0)
+    meta_surface_actor_process_damage (META_SURFACE_ACTOR (self), 0, 0,
+                                       priv->last_width, priv->last_height);
+}
+
+/* A client drawing in many small pieces every frame (a terminal
+ * scrolling character by character, say) gets an event per piece with
+ * raw rectangles, and we spend the frame reading them. Once that keeps
+ * up for a few frames, let the server accumulate the damage for us
+ * instead.
+ */
+static void
+check_damage_flood (MetaSurfaceActorX11 *self)
+{
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
+
+  if (priv->n_damage_events > DAMAGE_FLOOD_EVENTS)
+    priv->flooded_frames_count++;
+  else
+    priv->flooded_frames_count = 0;
+
+  priv->n_damage_events = 0;
+
+  if (priv->flooded_frames_count >= DAMAGE_FLOOD_FRAMES)
+    set_coarse_damage (self, TRUE);
+}
+
+/* With bounding boxes, a surface that draws a little in one corner and
+ * a little in the other gets everything in between repainted. Once it
+ * has stopped drawing for a while, go back to raw rectangles.
+ */
+static void
+check_damage_quiet (MetaSurfaceActorX11 *self)
 {
-  MetaSurfaceActorX11 *self = META_SURFACE_ACTOR_X11 (actor);
   MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
   MetaDisplay *display = priv->display;
-  Display *xdisplay = meta_display_get_xdisplay (display);
 
   if (priv->received_damage)
     {
       meta_error_trap_push (display);
-      XDamageSubtract (xdisplay, priv->damage, None, None);
+      XDamageSubtract (meta_display_get_xdisplay (display),
+                       priv->damage, None, None);
       meta_error_trap_pop (display);
 
       priv->received_damage = FALSE;
+      priv->quiet_frames_count = 0;
+      display->compositor->frame_has_subtracted_damage = TRUE;
+      return;
     }
 
+  priv->quiet_frames_count++;
+
+  if (priv->quiet_frames_count >= DAMAGE_QUIET_FRAMES)
+    set_coarse_damage (self, FALSE);
+}
+
+static void
+meta_surface_actor_x11_pre_paint (MetaSurfaceActor *actor)
+{
+  MetaSurfaceActorX11 *self = META_SURFACE_ACTOR_X11 (actor);
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
+
+  /* In case the rest of a batch is still on its way */
+  flush_damage (self);
+
+  if (!priv->coarse_damage)
+    check_damage_flood (self);
+  else
+    check_damage_quiet (self);
+
   update_pixmap (self);
 }
 
@@ -361,9 +525,11 @@ static void
 meta_surface_actor_x11_dispose (GObject *object)
 {
   MetaSurfaceActorX11 *self = META_SURFACE_ACTOR_X11 (object);
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
 
   detach_pixmap (self);
   free_damage (self);
+  g_clear_pointer (&priv->pending_damage, cairo_region_destroy);
 
   G_OBJECT_CLASS (meta_surface_actor_x11_parent_class)->dispose (object);
 }
@@ -411,7 +577,18 @@ create_damage (MetaSurfaceActorX11 *self)
   Display *xdisplay = meta_display_get_xdisplay (priv->display);
   Window xwindow = meta_window_x11_get_toplevel_xwindow (priv->window);
 
-  priv->damage = XDamageCreate (xdisplay, xwindow, XDamageReportBoundingBox);
+  /* With raw rectangles the server reports each piece of drawing as it
+   * happens and doesn't accumulate a region we would have to
+   * XDamageSubtract(), so nothing drawn before an event we processed
+   * can be missed, and we repaint exactly what changed rather than the
+   * bounding box of it. Surfaces that flood us with those get the
+   * bounding box until they calm down, see check_damage_flood() and
+   * check_damage_quiet().
+   */
+  priv->damage = XDamageCreate (xdisplay, xwindow,
+                                priv->coarse_damage ?
+                                XDamageReportBoundingBox :
+                                XDamageReportRawRectangles);
 }
 
 static void
@@ -420,7 +597,11 @@ window_decorated_notify (MetaWindow *window,
                          gpointer    user_data)
 {
   MetaSurfaceActorX11 *self = META_SURFACE_ACTOR_X11 (user_data);
+  MetaSurfaceActorX11Private *priv = meta_surface_actor_x11_get_instance_private (self);
 
+  /* Damage for the old toplevel is meaningless for the new one */
+  g_clear_pointer (&priv->pending_damage, cairo_region_destroy);
+  priv->received_damage = FALSE;
   detach_pixmap (self);
   free_damage (self);
   create_damage (self);
@@ -64,6 +64,9 @@ MetaSurfaceActor * meta_surface_actor_x11_new (MetaWindow *window);
 void meta_surface_actor_x11_set_size (MetaSurfaceActorX11 *self,
                                       int width, int height);
 
+void meta_surface_actor_x11_add_damage (MetaSurfaceActorX11 *self,
+                                        XDamageNotifyEvent  *event);
+
 G_END_DECLS
 
 #endif /* __META_SURFACE_ACTOR_X11_H__ */
@@ -1719,11 +1719,8 @@ meta_window_actor_process_x11_damage (MetaWindowActor    *self,
   MetaWindowActorPrivate *priv = self->priv;
 
   if (priv->surface)
-    meta_surface_actor_process_damage (priv->surface,
-                                       event->area.x,
-                                       event->area.y,
-                                       event->area.width,
-                                       event->area.height);
+    meta_surface_actor_x11_add_damage (META_SURFACE_ACTOR_X11 (priv->surface),
+                                       event);
 }
 
 void
@@ -215,4 +215,19 @@ GList* meta_rectangle_find_nonintersected_monitor_edges (
                                            const GList         *monitor_rects,
                                            const GSList        *all_struts);
 
+/* A grid-bucketed set of rectangles which answers "does this rectangle
+ * overlap any of them?" by looking only at rectangles sharing a grid cell
+ * with the query, rather than at every rectangle in the set.  bounds only
+ * determines the grid; rectangles (partially) outside of it are still
+ * handled correctly, just less efficiently.
+ */
+typedef struct _MetaRectangleIndex MetaRectangleIndex;
+
+MetaRectangleIndex* meta_rectangle_index_new      (const MetaRectangle *bounds);
+void                meta_rectangle_index_free     (MetaRectangleIndex  *index);
+void                meta_rectangle_index_add      (MetaRectangleIndex  *index,
+                                                   const MetaRectangle *rect);
+gboolean            meta_rectangle_index_overlaps (MetaRectangleIndex  *index,
+                                                   const MetaRectangle *rect);
+
 #endif /* META_BOXES_PRIVATE_H */
@@ -2013,3 +2013,185 @@ meta_rectangle_find_nonintersected_monitor_edges (
 
   return ret;
 }
+
+/* Number of grid cells along each axis of a MetaRectangleIndex */
+#define RECTANGLE_INDEX_GRID_SIZE 16
+
+struct _MetaRectangleIndex
+{
+  MetaRectangle bounds;
+  int           cell_width;
+  int           cell_height;
+
+  GArray       *rects;    /* MetaRectangle */
+  GArray       *stamps;   /* guint, per rect; see meta_rectangle_index_overlaps */
+  guint         stamp;
+
+  /* Indices into rects of the rectangles touching each cell */
+  GArray       *cells[RECTANGLE_INDEX_GRID_SIZE * RECTANGLE_INDEX_GRID_SIZE];
+
+  /* Whether some rectangle covers each cell entirely, in which case
+   * anything touching the cell overlaps.  This is what keeps queries
+   * cheap where many windows are piled on top of each other.
+   */
+  gboolean      covered[RECTANGLE_INDEX_GRID_SIZE * RECTANGLE_INDEX_GRID_SIZE];
+};
+
+MetaRectangleIndex *
+meta_rectangle_index_new (const MetaRectangle *bounds)
+{
+  MetaRectangleIndex *index;
+
+  index = g_new0 (MetaRectangleIndex, 1);
+  index->bounds = *bounds;
+  index->cell_width  = MAX (1, (bounds->width  + RECTANGLE_INDEX_GRID_SIZE - 1) /
+                               RECTANGLE_INDEX_GRID_SIZE);
+  index->cell_height = MAX (1, (bounds->height + RECTANGLE_INDEX_GRID_SIZE - 1) /
+                               RECTANGLE_INDEX_GRID_SIZE);
+  index->rects  = g_array_new (FALSE, FALSE, sizeof (MetaRectangle));
+  index->stamps = g_array_new (FALSE, TRUE, sizeof (guint));
+
+  return index;
+}
+
+void
+meta_rectangle_index_free (MetaRectangleIndex *index)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (index->cells); i++)
+    if (index->cells[i])
+      g_array_free (index->cells[i], TRUE);
+
+  g_array_free (index->rects, TRUE);
+  g_array_free (index->stamps, TRUE);
+  g_free (index);
+}
+
+/* Finds the range of grid cells covered by rect; rectangles extending
+ * past the bounds are accounted to the outermost cells.  Returns FALSE
+ * for degenerate rectangles, which cannot overlap anything.
+ */
+static gboolean
+rectangle_index_get_cells (MetaRectangleIndex  *index,
+                           const MetaRectangle *rect,
+                           int                 *col1,
+                           int                 *row1,
+                           int                 *col2,
+                           int                 *row2)
+{
+  const int last = RECTANGLE_INDEX_GRID_SIZE - 1;
+
+  if (rect->width <= 0 || rect->height <= 0)
+    return FALSE;
+
+  *col1 = CLAMP ((rect->x - index->bounds.x) / index->cell_width, 0, last);
+  *row1 = CLAMP ((rect->y - index->bounds.y) / index->cell_height, 0, last);
+  *col2 = CLAMP ((rect->x + rect->width - 1 - index->bounds.x) /
+                 index->cell_width, 0, last);
+  *row2 = CLAMP ((rect->y + rect->height - 1 - index->bounds.y) /
+                 index->cell_height, 0, last);
+
+  return TRUE;
+}
+
+static MetaRectangle
+rectangle_index_get_cell_rect (MetaRectangleIndex *index,
+                               int                 col,
+                               int                 row)
+{
+  return meta_rect (index->bounds.x + col * index->cell_width,
+                    index->bounds.y + row * index->cell_height,
+                    index->cell_width,
+                    index->cell_height);
+}
+
+void
+meta_rectangle_index_add (MetaRectangleIndex  *index,
+                          const MetaRectangle *rect)
+{
+  int col1, row1, col2, row2, col, row;
+  guint rect_index;
+
+  if (!rectangle_index_get_cells (index, rect, &col1, &row1, &col2, &row2))
+    return;
+
+  rect_index = index->rects->len;
+  g_array_append_val (index->rects, *rect);
+  g_array_set_size (index->stamps, index->rects->len);
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        int cell_index = row * RECTANGLE_INDEX_GRID_SIZE + col;
+        GArray **cell = &index->cells[cell_index];
+        MetaRectangle cell_rect;
+
+        if (*cell == NULL)
+          *cell = g_array_new (FALSE, FALSE, sizeof (guint));
+        g_array_append_val (*cell, rect_index);
+
+        cell_rect = rectangle_index_get_cell_rect (index, col, row);
+        if (meta_rectangle_contains_rect (rect, &cell_rect))
+          index->covered[cell_index] = TRUE;
+      }
+}
+
+gboolean
+meta_rectangle_index_overlaps (MetaRectangleIndex  *index,
+                               const MetaRectangle *rect)
+{
+  int col1, row1, col2, row2, col, row;
+  guint i;
+
+  if (!rectangle_index_get_cells (index, rect, &col1, &row1, &col2, &row2))
+    return FALSE;
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        MetaRectangle cell_rect;
+
+        if (!index->covered[row * RECTANGLE_INDEX_GRID_SIZE + col])
+          continue;
+
+        /* Cells at the border also hold what lies beyond the bounds, so
+         * make sure rect really reaches into the covered cell.
+         */
+        cell_rect = rectangle_index_get_cell_rect (index, col, row);
+        if (meta_rectangle_overlap (rect, &cell_rect))
+          return TRUE;
+      }
+
+  /* A rectangle spanning several cells is listed in each of them; the
+   * per-query stamp makes sure we only compare against it once.
+   */
+  index->stamp++;
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        GArray *cell = index->cells[row * RECTANGLE_INDEX_GRID_SIZE + col];
+
+        if (cell == NULL)
+          continue;
+
+        for (i = 0; i < cell->len; i++)
+          {
+            guint rect_index = g_array_index (cell, guint, i);
+            guint *stamp = &g_array_index (index->stamps, guint, rect_index);
+
+            if (*stamp == index->stamp)
+              continue;
+            *stamp = index->stamp;
+
+            if (meta_rectangle_overlap (rect,
+                                        &g_array_index (index->rects,
+                                                        MetaRectangle,
+                                                        rect_index)))
+              return TRUE;
+          }
+      }
+
+  return FALSE;
+}
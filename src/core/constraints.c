@@ -204,6 +204,8 @@ static void place_window_if_needed       (MetaWindow     *window,
                                           ConstraintInfo *info);
 static void update_onscreen_requirements (MetaWindow     *window,
                                           ConstraintInfo *info);
+static void update_constraint_envelope   (MetaWindow     *window,
+                                          ConstraintInfo *info);
 
 typedef gboolean (* ConstraintFunc) (MetaWindow         *window,
                                      ConstraintInfo     *info,
@@ -270,6 +272,71 @@ do_all_constraints (MetaWindow         *window,
   return TRUE;
 }
 
+/* How many times meta_window_constrain() ran the full solver, and how
+ * many times the cached constraint envelope let it skip the solver.
+ */
+static guint n_full_solves = 0;
+static guint n_fast_solves = 0;
+
+/* The constraint envelope only accounts for the constraints that keep a
+ * window inside the usable screen and monitor regions.  It is therefore
+ * only usable if none of the other constraints can apply: they depend
+ * on the size of the window (size increments, size limits, aspect
+ * ratio), on maximization, tiling or fullscreen state, on the parent of
+ * an attached dialog, or on a pending placement.
+ */
+static gboolean
+window_state_allows_envelope (MetaWindow *window)
+{
+  if (window->type == META_WINDOW_DESKTOP ||
+      window->type == META_WINDOW_DOCK)
+    return FALSE;
+
+  if (window->maximized_horizontally ||
+      window->maximized_vertically   ||
+      window->fullscreen             ||
+      meta_window_is_attached_dialog (window))
+    return FALSE;
+
+  if (!window->placed                                 ||
+      window->maximize_horizontally_after_placement   ||
+      window->maximize_vertically_after_placement     ||
+      window->minimize_after_placement)
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+try_constrain_within_envelope (MetaWindow          *window,
+                               MetaMoveResizeFlags  flags,
+                               const MetaRectangle *orig,
+                               const MetaRectangle *new)
+{
+  MetaWorkspace *cur_workspace;
+
+  if (window->constraint_envelope_serial == 0)
+    return FALSE;
+
+  /* Only plain moves; anything changing the size needs the full solver */
+  if (!(flags & META_MOVE_RESIZE_MOVE_ACTION) ||
+      (flags & META_MOVE_RESIZE_RESIZE_ACTION) ||
+      orig->width  != new->width ||
+      orig->height != new->height)
+    return FALSE;
+
+  if (!window_state_allows_envelope (window))
+    return FALSE;
+
+  /* Revalidates the work areas (and thus the serial) if needed */
+  cur_workspace = window->screen->active_workspace;
+  meta_workspace_get_onscreen_region (cur_workspace);
+  if (window->constraint_envelope_serial != cur_workspace->work_area_serial)
+    return FALSE;
+
+  return meta_rectangle_contains_rect (&window->constraint_envelope, new);
+}
+
 void
 meta_window_constrain (MetaWindow          *window,
                        MetaMoveResizeFlags  flags,
@@ -287,6 +354,23 @@ meta_window_constrain (MetaWindow          *window,
               orig->x, orig->y, orig->width, orig->height,
               new->x,  new->y,  new->width,  new->height);
 
+  /* Every constraint is already satisfied anywhere inside the envelope,
+   * so the full solver would leave *new untouched.  The envelope only
+   * exists after a user action solve, which set the onscreen requirements
+   * the same way it would for any position inside it.
+   */
+  if (try_constrain_within_envelope (window, flags, orig, new))
+    {
+      n_fast_solves++;
+      meta_topic (META_DEBUG_GEOMETRY,
+                  "%s stays within its constraint envelope "
+                  "(%u fast / %u full solves)\n",
+                  window->desc, n_fast_solves, n_full_solves);
+      return;
+    }
+
+  n_full_solves++;
+
   setup_constraint_info (&info,
                          window,
                          flags,
@@ -318,6 +402,9 @@ meta_window_constrain (MetaWindow          *window,
    * if this was a user move or user move-and-resize operation.
    */
   update_onscreen_requirements (window, &info);
+
+  /* Remember where subsequent moves can skip the solver */
+  update_constraint_envelope (window, &info);
 }
 
 static void
@@ -629,6 +716,66 @@ update_onscreen_requirements (MetaWindow     *window,
     }
 }
 
+static const MetaRectangle *
+find_containing_rect (const GList         *spanning_rects,
+                      const MetaRectangle *rect)
+{
+  const GList *temp;
+
+  for (temp = spanning_rects; temp != NULL; temp = temp->next)
+    if (meta_rectangle_contains_rect (temp->data, rect))
+      return temp->data;
+
+  return NULL;
+}
+
+static void
+update_constraint_envelope (MetaWindow     *window,
+                            ConstraintInfo *info)
+{
+  const MetaRectangle *screen_rect, *monitor_rect;
+
+  window->constraint_envelope_serial = 0;
+
+  /* The fast path skips update_onscreen_requirements().  Only hand out
+   * an envelope after a user action solve, which left the requirements
+   * set for a position inside the envelope; any other position inside it
+   * would set them the same way.
+   */
+  if (!info->is_user_action)
+    return;
+
+  if (!window_state_allows_envelope (window))
+    return;
+
+  /* Any frame rect inside a spanning rectangle of both the usable screen
+   * region and the usable monitor region satisfies the fully-onscreen,
+   * single-monitor, titlebar-visible and partially-onscreen constraints,
+   * which are the only ones left for a plain move of a window in this
+   * state.  Their intersection is the envelope.
+   */
+  screen_rect  = find_containing_rect (info->usable_screen_region,
+                                       &info->current);
+  monitor_rect = find_containing_rect (info->usable_monitor_region,
+                                       &info->current);
+  if (screen_rect == NULL || monitor_rect == NULL)
+    return;
+
+  if (!meta_rectangle_intersect (screen_rect, monitor_rect,
+                                 &window->constraint_envelope))
+    return;
+
+  window->constraint_envelope_serial =
+    window->screen->active_workspace->work_area_serial;
+
+  meta_topic (META_DEBUG_GEOMETRY,
+              "Constraint envelope for %s is %d,%d +%d,%d\n",
+              window->desc,
+              window->constraint_envelope.x, window->constraint_envelope.y,
+              window->constraint_envelope.width,
+              window->constraint_envelope.height);
+}
+
 static inline void
 get_size_limits (MetaWindow    *window,
                  MetaRectangle *min_size,
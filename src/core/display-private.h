@@ -225,6 +225,20 @@ struct _MetaDisplay
   MetaEdgeResistanceData *grab_edge_resistance_data;
   unsigned int grab_last_user_action_was_snap;
 
+  /* Pointer motion during mouse move/resize grab ops is coalesced and
+   * applied once per stage frame; see queue_grab_motion() in window.c
+   */
+  guint       grab_motion_later_id;
+  float       grab_motion_x;
+  float       grab_motion_y;
+  gboolean    grab_motion_snap;
+  guint       grab_motion_n_samples;
+  gint64      grab_motion_sample_time;
+  double      grab_motion_velocity_x;  /* pixels per microsecond */
+  double      grab_motion_velocity_y;
+  gint64      grab_motion_frame_time;
+  gint64      grab_motion_frame_interval;
+
   /* we use property updates as sentinels for certain window focus events
    * to avoid some race conditions on EnterNotify events
    */
@@ -252,6 +266,7 @@ struct _MetaDisplay
   MetaWindowPropHooks *prop_hooks_table;
   GHashTable *prop_hooks;
   int n_prop_hooks;
+  GSource *prop_fetch_source;
 
   /* Managed by group-props.c */
   MetaGroupPropHooks *group_prop_hooks;
@@ -277,6 +292,9 @@ struct _MetaDisplay
   int xinput_event_base;
   int xinput_opcode;
 
+  /* Redundant events skipped by the look-ahead in events.c */
+  guint n_collapsed_xevents;
+
   MetaStartupNotification *startup_notification;
 
   int xsync_event_base;
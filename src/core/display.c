@@ -151,8 +151,9 @@ static const char *net_wm_name = "Mutter";
 
 static void update_cursor_theme (void);
 
-static void    prefs_changed_callback    (MetaPreference pref,
-                                          void          *data);
+static void    prefs_changed_callback    (const MetaPreference *prefs,
+                                          guint                 n_prefs,
+                                          gpointer              data);
 
 static int mru_cmp (gconstpointer a,
                     gconstpointer b);
@@ -604,7 +605,7 @@ meta_display_open (void)
 
   meta_display_init_keys (display);
 
-  meta_prefs_add_listener (prefs_changed_callback, display);
+  meta_prefs_add_batch_listener (prefs_changed_callback, display);
 
   meta_verbose ("Creating %d atoms\n", (int) G_N_ELEMENTS (atom_names));
   XInternAtoms (display->xdisplay, (char **)atom_names, G_N_ELEMENTS (atom_names),
@@ -653,6 +654,7 @@ meta_display_open (void)
   display->sentinel_counter = 0;
 
   display->grab_resize_timeout_id = 0;
+  display->grab_motion_later_id = 0;
   display->grab_have_keyboard = FALSE;
 
   display->last_bell_time = 0;
@@ -1097,7 +1099,7 @@ meta_display_close (MetaDisplay *display,
 
   display->closing += 1;
 
-  meta_prefs_remove_listener (prefs_changed_callback, display);
+  meta_prefs_remove_batch_listener (prefs_changed_callback, display);
 
   meta_display_remove_autoraise_callback (display);
 
@@ -1915,6 +1917,12 @@ meta_display_begin_grab_op (MetaDisplay *display,
   display->grab_last_moveresize_time.tv_usec = 0;
   display->grab_last_user_action_was_snap = FALSE;
   display->grab_frame_action = frame_action;
+  display->grab_motion_n_samples = 0;
+  display->grab_motion_sample_time = 0;
+  display->grab_motion_velocity_x = 0.0;
+  display->grab_motion_velocity_y = 0.0;
+  display->grab_motion_frame_time = 0;
+  display->grab_motion_frame_interval = G_USEC_PER_SEC / 60;
 
   meta_display_update_cursor (display);
 
@@ -1924,6 +1932,12 @@ meta_display_begin_grab_op (MetaDisplay *display,
       display->grab_resize_timeout_id = 0;
     }
 
+  if (display->grab_motion_later_id)
+    {
+      meta_later_remove (display->grab_motion_later_id);
+      display->grab_motion_later_id = 0;
+    }
+
   meta_topic (META_DEBUG_WINDOW_OPS,
               "Grab op %u on window %s successful\n",
               display->grab_op, window ? window->desc : "(null)");
@@ -2025,6 +2039,12 @@ meta_display_end_grab_op (MetaDisplay *display,
       display->grab_resize_timeout_id = 0;
     }
 
+  if (display->grab_motion_later_id)
+    {
+      meta_later_remove (display->grab_motion_later_id);
+      display->grab_motion_later_id = 0;
+    }
+
   if (meta_is_wayland_compositor ())
     meta_display_sync_wayland_input_focus (display);
 }
@@ -2725,12 +2745,36 @@ meta_display_sort_windows_by_stacking (MetaDisplay *display,
 }
 
 static void
-prefs_changed_callback (MetaPreference pref,
-                        void          *data)
+prefs_changed_callback (const MetaPreference *prefs,
+                        guint                 n_prefs,
+                        gpointer              data)
 {
   MetaDisplay *display = data;
+  gboolean focus_mode_changed = FALSE;
+  gboolean bell_changed = FALSE;
+  gboolean cursor_changed = FALSE;
+  guint i;
 
-  if (pref == META_PREF_FOCUS_MODE)
+  for (i = 0; i < n_prefs; i++)
+    {
+      switch (prefs[i])
+        {
+        case META_PREF_FOCUS_MODE:
+          focus_mode_changed = TRUE;
+          break;
+        case META_PREF_AUDIBLE_BELL:
+          bell_changed = TRUE;
+          break;
+        case META_PREF_CURSOR_THEME:
+        case META_PREF_CURSOR_SIZE:
+          cursor_changed = TRUE;
+          break;
+        default:
+          break;
+        }
+    }
+
+  if (focus_mode_changed)
     {
       GSList *windows, *l;
       windows = meta_display_list_windows (display, META_LIST_DEFAULT);
@@ -2745,15 +2789,13 @@ prefs_changed_callback (MetaPreference pref,
 
       g_slist_free (windows);
     }
-  else if (pref == META_PREF_AUDIBLE_BELL)
-    {
-      meta_bell_set_audible (display, meta_prefs_bell_is_audible ());
-    }
-  else if (pref == META_PREF_CURSOR_THEME ||
-           pref == META_PREF_CURSOR_SIZE)
-    {
-      update_cursor_theme ();
-    }
+
+  if (bell_changed)
+    meta_bell_set_audible (display, meta_prefs_bell_is_audible ());
+
+  /* Theme and size often change together; reload the cursors once */
+  if (cursor_changed)
+    update_cursor_theme ();
 }
 
 void
@@ -221,8 +221,28 @@ meta_display_handle_event (MetaDisplay        *display,
 
   if (meta_is_wayland_compositor () && event->type == CLUTTER_MOTION)
     {
+      float x = event->motion.x;
+      float y = event->motion.y;
+
+#ifdef HAVE_NATIVE_BACKEND
+      /* The native backend already moved the cursor when the motion was
+       * read from the device, possibly further than this event; don't
+       * move it back. */
+      if (META_IS_BACKEND_NATIVE (meta_get_backend ()))
+        {
+          ClutterPoint position;
+
+          if (clutter_input_device_get_coords (clutter_event_get_device (event),
+                                               NULL, &position))
+            {
+              x = position.x;
+              y = position.y;
+            }
+        }
+#endif
+
       meta_cursor_tracker_update_position (meta_cursor_tracker_get_for_screen (NULL),
-                                           event->motion.x, event->motion.y);
+                                           x, y);
       display->monitor_cache_invalidated = TRUE;
     }
 
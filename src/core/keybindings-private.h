@@ -68,6 +68,10 @@ struct _MetaKeyBinding
   MetaResolvedKeyCombo resolved_combo;
   gint flags;
   MetaKeyHandler *handler;
+
+  /* What get_keybinding_action() returns, resolved when the binding
+   * table is built rather than on every key event */
+  guint action;
 };
 
 typedef struct
@@ -132,8 +132,17 @@ static gboolean process_keyboard_resize_grab (MetaDisplay     *display,
                                               MetaWindow      *window,
                                               ClutterKeyEvent *event);
 
-static void grab_key_bindings           (MetaDisplay *display);
-static void ungrab_key_bindings         (MetaDisplay *display);
+typedef struct
+{
+  GHashTable *root_combos;
+  GHashTable *window_combos;
+  xkb_mod_mask_t ignored_modifier_mask;
+} MetaKeyGrabState;
+
+static void save_key_grab_state         (MetaKeyBindingManager *keys,
+                                         MetaKeyGrabState      *state);
+static void update_key_grabs            (MetaDisplay           *display,
+                                         MetaKeyGrabState      *old_state);
 
 static GHashTable *key_handlers;
 static GHashTable *external_grabs;
@@ -566,6 +575,17 @@ reload_combos (MetaKeyBindingManager *keys)
   g_hash_table_foreach (keys->key_bindings, binding_reload_combos_foreach, keys);
 }
 
+static guint
+binding_action_for_name (const char *name)
+{
+  MetaKeyGrab *grab = g_hash_table_lookup (external_grabs, name);
+
+  if (grab)
+    return grab->action;
+  else
+    return (guint) meta_prefs_get_keybinding_action (name);
+}
+
 static void
 rebuild_binding_table (MetaKeyBindingManager *keys,
                        GList                  *prefs,
@@ -595,6 +615,7 @@ rebuild_binding_table (MetaKeyBindingManager *keys,
               b->handler = handler;
               b->flags = handler->flags;
               b->combo = *combo;
+              b->action = binding_action_for_name (pref->name);
 
               g_hash_table_add (keys->key_bindings, b);
             }
@@ -618,6 +639,7 @@ rebuild_binding_table (MetaKeyBindingManager *keys,
           b->handler = handler;
           b->flags = handler->flags;
           b->combo = grab->combo;
+          b->action = grab->action;
 
           g_hash_table_add (keys->key_bindings, b);
         }
@@ -654,40 +676,6 @@ rebuild_special_bindings (MetaKeyBindingManager *keys)
   keys->overlay_key_combo = combo;
 }
 
-static void
-ungrab_key_bindings (MetaDisplay *display)
-{
-  GSList *windows, *l;
-
-  meta_screen_ungrab_keys (display->screen);
-
-  windows = meta_display_list_windows (display, META_LIST_DEFAULT);
-  for (l = windows; l; l = l->next)
-    {
-      MetaWindow *w = l->data;
-      meta_window_ungrab_keys (w);
-    }
-
-  g_slist_free (windows);
-}
-
-static void
-grab_key_bindings (MetaDisplay *display)
-{
-  GSList *windows, *l;
-
-  meta_screen_grab_keys (display->screen);
-
-  windows = meta_display_list_windows (display, META_LIST_DEFAULT);
-  for (l = windows; l; l = l->next)
-    {
-      MetaWindow *w = l->data;
-      meta_window_grab_keys (w);
-    }
-
-  g_slist_free (windows);
-}
-
 static MetaKeyBinding *
 get_keybinding (MetaKeyBindingManager *keys,
                 MetaResolvedKeyCombo  *resolved_combo)
@@ -829,13 +817,7 @@ get_keybinding_action (MetaKeyBindingManager *keys,
 
   binding = get_keybinding (keys, resolved_combo);
   if (binding)
-    {
-      MetaKeyGrab *grab = g_hash_table_lookup (external_grabs, binding->name);
-      if (grab)
-        return grab->action;
-      else
-        return (guint) meta_prefs_get_keybinding_action (binding->name);
-    }
+    return binding->action;
   else
     {
       return META_KEYBINDING_ACTION_NONE;
@@ -883,8 +865,9 @@ on_keymap_changed (MetaBackend *backend,
 {
   MetaDisplay *display = user_data;
   MetaKeyBindingManager *keys = &display->key_binding_manager;
+  MetaKeyGrabState old_grabs;
 
-  ungrab_key_bindings (display);
+  save_key_grab_state (keys, &old_grabs);
 
   /* Deciphering the modmap depends on the loaded keysyms to find out
    * what modifiers is Super and so forth, so we need to reload it
@@ -893,7 +876,7 @@ on_keymap_changed (MetaBackend *backend,
 
   reload_combos (keys);
 
-  grab_key_bindings (display);
+  update_key_grabs (display, &old_grabs);
 }
 
 static void
@@ -1099,11 +1082,15 @@ prefs_changed_callback (MetaPreference pref,
   switch (pref)
     {
     case META_PREF_KEYBINDINGS:
-      ungrab_key_bindings (display);
-      rebuild_key_binding_table (keys);
-      rebuild_special_bindings (keys);
-      reload_combos (keys);
-      grab_key_bindings (display);
+      {
+        MetaKeyGrabState old_grabs;
+
+        save_key_grab_state (keys, &old_grabs);
+        rebuild_key_binding_table (keys);
+        rebuild_special_bindings (keys);
+        reload_combos (keys);
+        update_key_grabs (display, &old_grabs);
+      }
       break;
     case META_PREF_MOUSE_BUTTON_MODS:
       {
@@ -1146,10 +1133,11 @@ meta_display_shutdown_keys (MetaDisplay *display)
 
 /* Grab/ungrab, ignoring all annoying modifiers like NumLock etc. */
 static void
-meta_change_keygrab (MetaKeyBindingManager *keys,
-                     Window                 xwindow,
-                     gboolean               grab,
-                     MetaResolvedKeyCombo  *resolved_combo)
+meta_change_keygrab_full (MetaKeyBindingManager *keys,
+                          Window                 xwindow,
+                          gboolean               grab,
+                          MetaResolvedKeyCombo  *resolved_combo,
+                          xkb_mod_mask_t         ignored_modifier_mask)
 {
   unsigned int ignored_mask;
 
@@ -1176,11 +1164,11 @@ meta_change_keygrab (MetaKeyBindingManager *keys,
               resolved_combo->keycode, resolved_combo->mask, xwindow);
 
   ignored_mask = 0;
-  while (ignored_mask <= keys->ignored_modifier_mask)
+  while (ignored_mask <= ignored_modifier_mask)
     {
       XIGrabModifiers mods;
 
-      if (ignored_mask & ~(keys->ignored_modifier_mask))
+      if (ignored_mask & ~(ignored_modifier_mask))
         {
           /* Not a combination of ignored modifiers
            * (it contains some non-ignored modifiers)
@@ -1206,6 +1194,16 @@ meta_change_keygrab (MetaKeyBindingManager *keys,
     }
 }
 
+static void
+meta_change_keygrab (MetaKeyBindingManager *keys,
+                     Window                 xwindow,
+                     gboolean               grab,
+                     MetaResolvedKeyCombo  *resolved_combo)
+{
+  meta_change_keygrab_full (keys, xwindow, grab, resolved_combo,
+                            keys->ignored_modifier_mask);
+}
+
 typedef struct
 {
   MetaKeyBindingManager *keys;
@@ -1358,6 +1356,173 @@ meta_window_ungrab_keys (MetaWindow  *window)
     }
 }
 
+/* The set of combos we grab, as key_combo_key() values; either those
+ * grabbed on the root window or those grabbed on every client window.
+ */
+static GHashTable *
+get_grabbed_combos (MetaKeyBindingManager *keys,
+                    gboolean               per_window)
+{
+  GHashTable *combos;
+  GHashTableIter iter;
+  gpointer value;
+
+  combos = g_hash_table_new (NULL, NULL);
+
+  if (!per_window)
+    {
+      int i;
+
+      if (keys->overlay_resolved_key_combo.keycode != 0)
+        g_hash_table_add (combos,
+                          GUINT_TO_POINTER (key_combo_key (&keys->overlay_resolved_key_combo)));
+
+      for (i = 0; i < keys->n_iso_next_group_combos; i++)
+        if (keys->iso_next_group_combos[i].keycode != 0)
+          g_hash_table_add (combos,
+                            GUINT_TO_POINTER (key_combo_key (&keys->iso_next_group_combos[i])));
+    }
+
+  g_hash_table_iter_init (&iter, keys->key_bindings);
+  while (g_hash_table_iter_next (&iter, &value, NULL))
+    {
+      MetaKeyBinding *binding = value;
+      gboolean binding_is_per_window = (binding->flags & META_KEY_BINDING_PER_WINDOW) != 0;
+
+      if (binding_is_per_window != per_window ||
+          binding->resolved_combo.keycode == 0)
+        continue;
+
+      g_hash_table_add (combos,
+                        GUINT_TO_POINTER (key_combo_key (&binding->resolved_combo)));
+    }
+
+  return combos;
+}
+
+static void
+save_key_grab_state (MetaKeyBindingManager *keys,
+                     MetaKeyGrabState      *state)
+{
+  state->root_combos = get_grabbed_combos (keys, FALSE);
+  state->window_combos = get_grabbed_combos (keys, TRUE);
+  state->ignored_modifier_mask = keys->ignored_modifier_mask;
+}
+
+/* Ungrabs what is in @old_combos but not in @new_combos and grabs the
+ * reverse, instead of redoing every grab. If the ignored modifiers
+ * changed, every grab expands differently and all of them are redone.
+ * Returns the number of combos changed.
+ */
+static guint
+change_keygrabs_diff (MetaKeyBindingManager *keys,
+                      Window                 xwindow,
+                      GHashTable            *old_combos,
+                      xkb_mod_mask_t         old_ignored_modifier_mask,
+                      GHashTable            *new_combos)
+{
+  gboolean full = old_ignored_modifier_mask != keys->ignored_modifier_mask;
+  GHashTableIter iter;
+  gpointer key;
+  guint n_changed = 0;
+
+  g_hash_table_iter_init (&iter, old_combos);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      guint32 index_key = GPOINTER_TO_UINT (key);
+      MetaResolvedKeyCombo combo = { index_key >> 16, index_key & 0xffff };
+
+      if (!full && g_hash_table_contains (new_combos, key))
+        continue;
+
+      meta_change_keygrab_full (keys, xwindow, FALSE, &combo,
+                                old_ignored_modifier_mask);
+      n_changed++;
+    }
+
+  g_hash_table_iter_init (&iter, new_combos);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      guint32 index_key = GPOINTER_TO_UINT (key);
+      MetaResolvedKeyCombo combo = { index_key >> 16, index_key & 0xffff };
+
+      if (!full && g_hash_table_contains (old_combos, key))
+        continue;
+
+      meta_change_keygrab (keys, xwindow, TRUE, &combo);
+      n_changed++;
+    }
+
+  return n_changed;
+}
+
+/* Brings the grabs on the root window and on all client windows from
+ * @old_state (saved before the binding table or the keymap changed) to
+ * what the current binding table asks for, and frees @old_state.
+ */
+static void
+update_key_grabs (MetaDisplay      *display,
+                  MetaKeyGrabState *old_state)
+{
+  MetaKeyBindingManager *keys = &display->key_binding_manager;
+  MetaScreen *screen = display->screen;
+  GHashTable *root_combos, *window_combos;
+  GSList *windows, *l;
+  guint n_changed = 0;
+
+  root_combos = get_grabbed_combos (keys, FALSE);
+  window_combos = get_grabbed_combos (keys, TRUE);
+
+  if (screen->keys_grabbed)
+    n_changed += change_keygrabs_diff (keys, screen->xroot,
+                                       old_state->root_combos,
+                                       old_state->ignored_modifier_mask,
+                                       root_combos);
+  else
+    meta_screen_grab_keys (screen);
+
+  windows = meta_display_list_windows (display, META_LIST_DEFAULT);
+  for (l = windows; l; l = l->next)
+    {
+      MetaWindow *w = l->data;
+
+      if (w->keys_grabbed)
+        {
+          Window xwindow;
+
+          if (!w->grab_on_frame)
+            xwindow = w->xwindow;
+          else if (w->frame)
+            xwindow = w->frame->xwindow;
+          else
+            xwindow = None; /* went away with the frame */
+
+          if (xwindow != None)
+            n_changed += change_keygrabs_diff (keys, xwindow,
+                                               old_state->window_combos,
+                                               old_state->ignored_modifier_mask,
+                                               window_combos);
+        }
+
+      /* Grabs windows we didn't grab on yet and deals with frames
+       * that came or went, as before */
+      meta_window_grab_keys (w);
+    }
+
+  g_slist_free (windows);
+
+  meta_topic (META_DEBUG_KEYBINDINGS,
+              "Updated key grabs: %u root and %u per-window combos, %u changed\n",
+              g_hash_table_size (root_combos),
+              g_hash_table_size (window_combos),
+              n_changed);
+
+  g_hash_table_destroy (root_combos);
+  g_hash_table_destroy (window_combos);
+  g_hash_table_destroy (old_state->root_combos);
+  g_hash_table_destroy (old_state->window_combos);
+}
+
 static void
 handle_external_grab (MetaDisplay     *display,
                       MetaScreen      *screen,
@@ -1413,6 +1578,7 @@ meta_display_grab_accelerator (MetaDisplay *display,
   binding->handler = HANDLER ("external-grab");
   binding->combo = combo;
   binding->resolved_combo = resolved_combo;
+  binding->action = grab->action;
 
   g_hash_table_add (keys->key_bindings, binding);
   index_binding (keys, binding);
@@ -400,6 +400,16 @@ init_backend (void)
 #endif
 }
 
+static gint64 startup_time = 0;
+
+/* Logs how far into startup we are, for the startup timeline */
+static void
+trace_startup_step (const char *step)
+{
+  meta_topic (META_DEBUG_STARTUP, "Startup: %s done at %.1f ms\n",
+              step, (g_get_monotonic_time () - startup_time) / 1000.0);
+}
+
 /**
  * meta_init: (skip)
  *
@@ -412,6 +422,8 @@ meta_init (void)
   struct sigaction act;
   sigset_t empty_mask;
 
+  startup_time = g_get_monotonic_time ();
+
   sigemptyset (&empty_mask);
   act.sa_handler = SIG_IGN;
   act.sa_mask    = empty_mask;
@@ -456,11 +468,15 @@ meta_init (void)
     meta_select_display (opt_display_name);
 
   meta_clutter_init ();
+  trace_startup_step ("backend");
 
 #ifdef HAVE_WAYLAND
   /* Bring up Wayland. This also launches Xwayland and sets DISPLAY as well... */
   if (meta_is_wayland_compositor ())
-    meta_wayland_init ();
+    {
+      meta_wayland_init ();
+      trace_startup_step ("wayland");
+    }
 #endif
 
   meta_set_syncing (opt_sync || (g_getenv ("MUTTER_SYNC") != NULL));
@@ -474,6 +490,7 @@ meta_init (void)
   meta_main_loop = g_main_loop_new (NULL, FALSE);
 
   meta_ui_init ();
+  trace_startup_step ("ui");
 
   meta_restart_init ();
 }
@@ -530,9 +547,11 @@ meta_run (void)
   /* Load prefs */
   meta_prefs_init ();
   meta_prefs_add_listener (prefs_changed_callback, NULL);
+  trace_startup_step ("prefs");
 
   if (!meta_display_open ())
     meta_exit (META_EXIT_ERROR);
+  trace_startup_step ("display");
 
   g_main_loop_run (meta_main_loop);
 
@@ -360,94 +360,71 @@ avoid_being_obscured_as_second_modal_dialog (MetaWindow *window,
 }
 
 static gboolean
-rectangle_overlaps_some_window (MetaRectangle *rect,
-                                GList         *windows)
+window_blocks_placement (MetaWindow *other)
 {
-  GList *tmp;
-  MetaRectangle dest;
-
-  tmp = windows;
-  while (tmp != NULL)
+  switch (other->type)
     {
-      MetaWindow *other = tmp->data;
-      MetaRectangle other_rect;
-
-      switch (other->type)
-        {
-        case META_WINDOW_DOCK:
-        case META_WINDOW_SPLASHSCREEN:
-        case META_WINDOW_DESKTOP:
-        case META_WINDOW_DIALOG:
-        case META_WINDOW_MODAL_DIALOG:
-	/* override redirect window types: */
-	case META_WINDOW_DROPDOWN_MENU:
-	case META_WINDOW_POPUP_MENU:
-	case META_WINDOW_TOOLTIP:
-	case META_WINDOW_NOTIFICATION:
-	case META_WINDOW_COMBO:
-	case META_WINDOW_DND:
-	case META_WINDOW_OVERRIDE_OTHER:
-          break;
-
-        case META_WINDOW_NORMAL:
-        case META_WINDOW_UTILITY:
-        case META_WINDOW_TOOLBAR:
-        case META_WINDOW_MENU:
-          meta_window_get_frame_rect (other, &other_rect);
-
-          if (meta_rectangle_intersect (rect, &other_rect, &dest))
-            return TRUE;
-          break;
-        }
+    case META_WINDOW_DOCK:
+    case META_WINDOW_SPLASHSCREEN:
+    case META_WINDOW_DESKTOP:
+    case META_WINDOW_DIALOG:
+    case META_WINDOW_MODAL_DIALOG:
+    /* override redirect window types: */
+    case META_WINDOW_DROPDOWN_MENU:
+    case META_WINDOW_POPUP_MENU:
+    case META_WINDOW_TOOLTIP:
+    case META_WINDOW_NOTIFICATION:
+    case META_WINDOW_COMBO:
+    case META_WINDOW_DND:
+    case META_WINDOW_OVERRIDE_OTHER:
+      return FALSE;
 
-      tmp = tmp->next;
+    case META_WINDOW_NORMAL:
+    case META_WINDOW_UTILITY:
+    case META_WINDOW_TOOLBAR:
+    case META_WINDOW_MENU:
+      return TRUE;
     }
 
   return FALSE;
 }
 
-static gint
-leftmost_cmp (gconstpointer a, gconstpointer b)
+/* The frame rect of a window, along with its position in the list of
+ * windows passed to find_first_fit(); the latter keeps the sort order
+ * identical to that of the stable g_list_sort() we used to use.
+ */
+typedef struct
 {
-  MetaWindow *aw = (gpointer) a;
-  MetaWindow *bw = (gpointer) b;
-  MetaRectangle a_frame;
-  MetaRectangle b_frame;
-  int ax, bx;
-
-  meta_window_get_frame_rect (aw, &a_frame);
-  meta_window_get_frame_rect (bw, &b_frame);
-  ax = a_frame.x;
-  bx = b_frame.x;
+  MetaRectangle frame_rect;
+  int           order;
+} PlacementFrame;
 
-  if (ax < bx)
-    return -1;
-  else if (ax > bx)
-    return 1;
-  else
-    return 0;
+/* Topmost first, then leftmost */
+static int
+below_cmp (const void *a, const void *b)
+{
+  const PlacementFrame *af = a;
+  const PlacementFrame *bf = b;
+
+  if (af->frame_rect.y != bf->frame_rect.y)
+    return af->frame_rect.y < bf->frame_rect.y ? -1 : 1;
+  if (af->frame_rect.x != bf->frame_rect.x)
+    return af->frame_rect.x < bf->frame_rect.x ? -1 : 1;
+  return af->order - bf->order;
 }
 
-static gint
-topmost_cmp (gconstpointer a, gconstpointer b)
+/* Leftmost first, then topmost */
+static int
+right_cmp (const void *a, const void *b)
 {
-  MetaWindow *aw = (gpointer) a;
-  MetaWindow *bw = (gpointer) b;
-  MetaRectangle a_frame;
-  MetaRectangle b_frame;
-  int ay, by;
-
-  meta_window_get_frame_rect (aw, &a_frame);
-  meta_window_get_frame_rect (bw, &b_frame);
-  ay = a_frame.y;
-  by = b_frame.y;
-
-  if (ay < by)
-    return -1;
-  else if (ay > by)
-    return 1;
-  else
-    return 0;
+  const PlacementFrame *af = a;
+  const PlacementFrame *bf = b;
+
+  if (af->frame_rect.x != bf->frame_rect.x)
+    return af->frame_rect.x < bf->frame_rect.x ? -1 : 1;
+  if (af->frame_rect.y != bf->frame_rect.y)
+    return af->frame_rect.y < bf->frame_rect.y ? -1 : 1;
+  return af->order - bf->order;
 }
 
 static void
@@ -492,25 +469,45 @@ find_first_fit (MetaWindow *window,
    * the bottom of each existing window, and then to the right
    * of each existing window, aligned with the left/top of the
    * existing window in each of those cases.
+   *
+   * Each candidate location has to be checked against all the other
+   * windows, so rather than walking the window list for each one, the
+   * occupied space is put into a MetaRectangleIndex first.  Together with
+   * fetching every frame rect only once, this keeps placement cheap even
+   * when restoring a session with hundreds of windows.
    */
   int retval;
-  GList *below_sorted;
-  GList *right_sorted;
+  PlacementFrame *below_sorted;
+  PlacementFrame *right_sorted;
+  MetaRectangleIndex *occupied;
   GList *tmp;
   MetaRectangle rect;
   MetaRectangle work_area;
+  int n_windows, i;
 
   retval = FALSE;
 
-  /* Below each window */
-  below_sorted = g_list_copy (windows);
-  below_sorted = g_list_sort (below_sorted, leftmost_cmp);
-  below_sorted = g_list_sort (below_sorted, topmost_cmp);
+  n_windows = g_list_length (windows);
+  below_sorted = g_new (PlacementFrame, n_windows);
+  occupied = meta_rectangle_index_new (&window->screen->rect);
+
+  for (tmp = windows, i = 0; tmp != NULL; tmp = tmp->next, i++)
+    {
+      MetaWindow *w = tmp->data;
+
+      meta_window_get_frame_rect (w, &below_sorted[i].frame_rect);
+      below_sorted[i].order = i;
+
+      if (window_blocks_placement (w))
+        meta_rectangle_index_add (occupied, &below_sorted[i].frame_rect);
+    }
 
   /* To the right of each window */
-  right_sorted = g_list_copy (windows);
-  right_sorted = g_list_sort (right_sorted, topmost_cmp);
-  right_sorted = g_list_sort (right_sorted, leftmost_cmp);
+  right_sorted = g_memdup (below_sorted, n_windows * sizeof (PlacementFrame));
+  qsort (right_sorted, n_windows, sizeof (PlacementFrame), right_cmp);
+
+  /* Below each window */
+  qsort (below_sorted, n_windows, sizeof (PlacementFrame), below_cmp);
 
   meta_window_get_frame_rect (window, &rect);
 
@@ -530,7 +527,7 @@ find_first_fit (MetaWindow *window,
   center_tile_rect_in_area (&rect, &work_area);
 
   if (meta_rectangle_contains_rect (&work_area, &rect) &&
-      !rectangle_overlaps_some_window (&rect, windows))
+      !meta_rectangle_index_overlaps (occupied, &rect))
     {
       *new_x = rect.x;
       *new_y = rect.y;
@@ -540,20 +537,23 @@ find_first_fit (MetaWindow *window,
       goto out;
     }
 
-  /* try below each window */
-  tmp = below_sorted;
-  while (tmp != NULL)
+  /* try below each window; cascaded windows of the same size often
+   * yield the same candidate several times in a row, only try it once.
+   */
+  for (i = 0; i < n_windows; i++)
     {
-      MetaWindow *w = tmp->data;
-      MetaRectangle frame_rect;
+      MetaRectangle *frame_rect = &below_sorted[i].frame_rect;
 
-      meta_window_get_frame_rect (w, &frame_rect);
+      if (i > 0 &&
+          frame_rect->x == rect.x &&
+          frame_rect->y + frame_rect->height == rect.y)
+        continue;
 
-      rect.x = frame_rect.x;
-      rect.y = frame_rect.y + frame_rect.height;
+      rect.x = frame_rect->x;
+      rect.y = frame_rect->y + frame_rect->height;
 
       if (meta_rectangle_contains_rect (&work_area, &rect) &&
-          !rectangle_overlaps_some_window (&rect, below_sorted))
+          !meta_rectangle_index_overlaps (occupied, &rect))
         {
           *new_x = rect.x;
           *new_y = rect.y;
@@ -562,24 +562,23 @@ find_first_fit (MetaWindow *window,
 
           goto out;
         }
-
-      tmp = tmp->next;
     }
 
   /* try to the right of each window */
-  tmp = right_sorted;
-  while (tmp != NULL)
+  for (i = 0; i < n_windows; i++)
     {
-      MetaWindow *w = tmp->data;
-      MetaRectangle frame_rect;
+      MetaRectangle *frame_rect = &right_sorted[i].frame_rect;
 
-      meta_window_get_frame_rect (w, &frame_rect);
+      if (i > 0 &&
+          frame_rect->x + frame_rect->width == rect.x &&
+          frame_rect->y == rect.y)
+        continue;
 
-      rect.x = frame_rect.x + frame_rect.width;
-      rect.y = frame_rect.y;
+      rect.x = frame_rect->x + frame_rect->width;
+      rect.y = frame_rect->y;
 
       if (meta_rectangle_contains_rect (&work_area, &rect) &&
-          !rectangle_overlaps_some_window (&rect, right_sorted))
+          !meta_rectangle_index_overlaps (occupied, &rect))
         {
           *new_x = rect.x;
           *new_y = rect.y;
@@ -588,13 +587,16 @@ find_first_fit (MetaWindow *window,
 
           goto out;
         }
-
-      tmp = tmp->next;
     }
 
  out:
-  g_list_free (below_sorted);
-  g_list_free (right_sorted);
+  meta_topic (META_DEBUG_PLACEMENT,
+              "First fit among %d windows %s\n",
+              n_windows, retval ? "succeeded" : "failed");
+
+  meta_rectangle_index_free (occupied);
+  g_free (below_sorted);
+  g_free (right_sorted);
   return retval;
 }
 
@@ -169,6 +169,7 @@ static void     init_bindings             (void);
 typedef struct
 {
   MetaPrefsChangedFunc func;
+  MetaPrefsBatchChangedFunc batch_func;
   gpointer data;
 } MetaPrefsListener;
 
@@ -837,13 +838,35 @@ meta_prefs_add_listener (MetaPrefsChangedFunc func,
 {
   MetaPrefsListener *l;
 
-  l = g_new (MetaPrefsListener, 1);
+  l = g_new0 (MetaPrefsListener, 1);
   l->func = func;
   l->data = user_data;
 
   listeners = g_list_prepend (listeners, l);
 }
 
+/**
+ * meta_prefs_add_batch_listener: (skip)
+ * @func: a #MetaPrefsBatchChangedFunc
+ * @user_data: data passed to the function
+ *
+ * Like meta_prefs_add_listener(), but @func is called once with all
+ * the preferences that changed together, so that listeners doing
+ * expensive work (regrabbing, reloading themes) only do it once.
+ */
+void
+meta_prefs_add_batch_listener (MetaPrefsBatchChangedFunc func,
+                               gpointer                  user_data)
+{
+  MetaPrefsListener *l;
+
+  l = g_new0 (MetaPrefsListener, 1);
+  l->batch_func = func;
+  l->data = user_data;
+
+  listeners = g_list_prepend (listeners, l);
+}
+
 /**
  * meta_prefs_remove_listener: (skip)
  * @func: a #MetaPrefsChangedFunc
@@ -876,6 +899,38 @@ meta_prefs_remove_listener (MetaPrefsChangedFunc func,
   meta_bug ("Did not find listener to remove\n");
 }
 
+/**
+ * meta_prefs_remove_batch_listener: (skip)
+ * @func: a #MetaPrefsBatchChangedFunc
+ * @user_data: data passed to the function
+ *
+ */
+void
+meta_prefs_remove_batch_listener (MetaPrefsBatchChangedFunc func,
+                                  gpointer                  user_data)
+{
+  GList *tmp;
+
+  tmp = listeners;
+  while (tmp != NULL)
+    {
+      MetaPrefsListener *l = tmp->data;
+
+      if (l->batch_func == func &&
+          l->data == user_data)
+        {
+          g_free (l);
+          listeners = g_list_delete_link (listeners, tmp);
+
+          return;
+        }
+
+      tmp = tmp->next;
+    }
+
+  meta_bug ("Did not find batch listener to remove\n");
+}
+
 static void
 emit_changed (MetaPreference pref)
 {
@@ -893,7 +948,35 @@ emit_changed (MetaPreference pref)
     {
       MetaPrefsListener *l = tmp->data;
 
-      (* l->func) (pref, l->data);
+      if (l->func)
+        (* l->func) (pref, l->data);
+
+      tmp = tmp->next;
+    }
+
+  g_list_free (copy);
+}
+
+static void
+emit_batch_changed (const MetaPreference *prefs,
+                    guint                 n_prefs)
+{
+  GList *tmp;
+  GList *copy;
+
+  meta_topic (META_DEBUG_PREFS, "Notifying batch listeners of %u changed prefs\n",
+              n_prefs);
+
+  copy = g_list_copy (listeners);
+
+  tmp = copy;
+
+  while (tmp != NULL)
+    {
+      MetaPrefsListener *l = tmp->data;
+
+      if (l->batch_func)
+        (* l->batch_func) (prefs, n_prefs, l->data);
 
       tmp = tmp->next;
     }
@@ -906,6 +989,7 @@ changed_idle_handler (gpointer data)
 {
   GList *tmp;
   GList *copy;
+  GArray *prefs;
 
   changed_idle = 0;
 
@@ -914,18 +998,26 @@ changed_idle_handler (gpointer data)
   g_list_free (changes);
   changes = NULL;
 
+  prefs = g_array_new (FALSE, FALSE, sizeof (MetaPreference));
+
   tmp = copy;
   while (tmp != NULL)
     {
       MetaPreference pref = GPOINTER_TO_INT (tmp->data);
 
       emit_changed (pref);
+      g_array_append_val (prefs, pref);
 
       tmp = tmp->next;
     }
 
   g_list_free (copy);
 
+  if (prefs->len > 0)
+    emit_batch_changed ((const MetaPreference *) prefs->data, prefs->len);
+
+  g_array_free (prefs, TRUE);
+
   return FALSE;
 }
 
@@ -1009,22 +1009,23 @@ void
 meta_screen_manage_all_windows (MetaScreen *screen)
 {
   guint64 *_children;
-  guint64 *children;
+  Window *children;
   int n_children, i;
 
   meta_stack_freeze (screen->stack);
   meta_stack_tracker_get_stack (screen->stack_tracker, &_children, &n_children);
 
   /* Copy the stack as it will be modified as part of the loop */
-  children = g_memdup (_children, sizeof (guint64) * n_children);
+  children = g_new (Window, n_children);
 
   for (i = 0; i < n_children; ++i)
     {
-      g_assert (META_STACK_ID_IS_X11 (children[i]));
-      meta_window_x11_new (screen->display, children[i], TRUE,
-                           META_COMP_EFFECT_NONE);
+      g_assert (META_STACK_ID_IS_X11 (_children[i]));
+      children[i] = _children[i];
     }
 
+  meta_window_x11_adopt_windows (screen->display, children, n_children);
+
   g_free (children);
   meta_stack_thaw (screen->stack);
 }
@@ -1923,24 +1924,13 @@ meta_screen_get_current_monitor_for_pos (MetaScreen *screen,
     return 0;
   else if (screen->display->monitor_cache_invalidated)
     {
+      MetaMonitorManager *manager = meta_monitor_manager_get ();
       int i;
-      MetaRectangle pointer_position;
-      pointer_position.x = x;
-      pointer_position.y = y;
-      pointer_position.width = pointer_position.height = 1;
 
       screen->display->monitor_cache_invalidated = FALSE;
-      screen->last_monitor_index = 0;
 
-      for (i = 0; i < screen->n_monitor_infos; i++)
-        {
-          if (meta_rectangle_contains_rect (&screen->monitor_infos[i].rect,
-                                            &pointer_position))
-            {
-              screen->last_monitor_index = i;
-              break;
-            }
-        }
+      i = meta_monitor_manager_get_monitor_at_point (manager, x, y);
+      screen->last_monitor_index = MAX (i, 0);
 
       meta_topic (META_DEBUG_XINERAMA,
                   "Rechecked current monitor, now %d\n",
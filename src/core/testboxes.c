@@ -20,6 +20,7 @@
  */
 
 #include "boxes-private.h"
+#include "backends/meta-barrier-index.h"
 #include <glib.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -1380,6 +1381,332 @@ test_find_closest_point_to_line (void)
   printf ("%s passed.\n", G_STRFUNC);
 }
 
+static void
+test_rectangle_index (void)
+{
+  MetaRectangle bounds = meta_rect (0, 0, 1600, 1200);
+  MetaRectangleIndex *index;
+  MetaRectangle rects[64];
+  MetaRectangle temp;
+  int i, j;
+
+  index = meta_rectangle_index_new (&bounds);
+  for (i = 0; i < (int) G_N_ELEMENTS (rects); i++)
+    {
+      /* Also put some of them (partially) outside of the bounds */
+      get_random_rect (&rects[i]);
+      rects[i].x -= 400;
+      rects[i].y -= 300;
+      meta_rectangle_index_add (index, &rects[i]);
+    }
+
+  for (i = 0; i < NUM_RANDOM_RUNS; i++)
+    {
+      gboolean overlaps = FALSE;
+
+      get_random_rect (&temp);
+      temp.width  /= 8;
+      temp.height /= 8;
+      temp.width  += 1;
+      temp.height += 1;
+      for (j = 0; j < (int) G_N_ELEMENTS (rects); j++)
+        overlaps = overlaps || meta_rectangle_overlap (&temp, &rects[j]);
+
+      g_assert (meta_rectangle_index_overlaps (index, &temp) == overlaps);
+    }
+
+  /* Degenerate rectangles never overlap anything */
+  temp = meta_rect (100, 100, 0, 100);
+  g_assert (!meta_rectangle_index_overlaps (index, &temp));
+
+  meta_rectangle_index_free (index);
+
+  printf ("%s passed.\n", G_STRFUNC);
+}
+
+static gboolean
+rect_is_free (const MetaRectangle *work_area,
+              const MetaRectangle *placed,
+              int                  n_placed,
+              MetaRectangleIndex  *index,
+              const MetaRectangle *rect)
+{
+  int i;
+
+  if (!meta_rectangle_contains_rect (work_area, rect))
+    return FALSE;
+
+  if (index)
+    return !meta_rectangle_index_overlaps (index, rect);
+
+  for (i = 0; i < n_placed; i++)
+    if (meta_rectangle_overlap (rect, &placed[i]))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* A first-fit-like workload for comparing MetaRectangleIndex with a
+ * linear overlap scan: try the center of the work area, then below and
+ * to the right of each placed rectangle. This is not place.c's
+ * find_first_fit(), only a query pattern resembling it.
+ */
+static gboolean
+first_fit (const MetaRectangle *work_area,
+           const MetaRectangle *placed,
+           int                  n_placed,
+           MetaRectangleIndex  *index,
+           MetaRectangle       *rect)
+{
+  int i;
+
+  rect->x = work_area->x + (work_area->width  - rect->width)  / 2;
+  rect->y = work_area->y + (work_area->height - rect->height) / 2;
+  if (rect_is_free (work_area, placed, n_placed, index, rect))
+    return TRUE;
+
+  for (i = 0; i < n_placed; i++)
+    {
+      rect->x = placed[i].x;
+      rect->y = placed[i].y + placed[i].height;
+      if (rect_is_free (work_area, placed, n_placed, index, rect))
+        return TRUE;
+    }
+
+  for (i = 0; i < n_placed; i++)
+    {
+      rect->x = placed[i].x + placed[i].width;
+      rect->y = placed[i].y;
+      if (rect_is_free (work_area, placed, n_placed, index, rect))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+place_rects (const MetaRectangle *work_area,
+             MetaRectangle       *placed,
+             int                  n_rects,
+             gboolean             use_index)
+{
+  MetaRectangleIndex *index = NULL;
+  int i;
+
+  if (use_index)
+    index = meta_rectangle_index_new (work_area);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      placed[i] = meta_rect (0, 0, 320 + (i % 7) * 10, 220 + (i % 5) * 10);
+
+      /* No fit; cascade */
+      if (!first_fit (work_area, placed, i, index, &placed[i]))
+        {
+          placed[i].x = work_area->x + (i * 15) % 400;
+          placed[i].y = work_area->y + (i * 15) % 300;
+        }
+
+      if (index)
+        meta_rectangle_index_add (index, &placed[i]);
+    }
+
+  if (index)
+    meta_rectangle_index_free (index);
+}
+
+static void
+test_rectangle_index_benchmark (void)
+{
+  const int n_rects = 500;
+  MetaRectangle work_area = meta_rect (0, 27, 3840, 2133);
+  MetaRectangle *linear, *indexed;
+  gint64 start, linear_time, indexed_time;
+  int i;
+
+  linear  = g_new (MetaRectangle, n_rects);
+  indexed = g_new (MetaRectangle, n_rects);
+
+  start = g_get_monotonic_time ();
+  place_rects (&work_area, linear, n_rects, FALSE);
+  linear_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  place_rects (&work_area, indexed, n_rects, TRUE);
+  indexed_time = g_get_monotonic_time () - start;
+
+  for (i = 0; i < n_rects; i++)
+    g_assert (meta_rectangle_equal (&linear[i], &indexed[i]));
+
+  printf ("Placing %d rectangles first fit:\n", n_rects);
+  printf ("  Linear scan      : %" G_GINT64_FORMAT " us\n", linear_time);
+  printf ("  Rectangle index  : %" G_GINT64_FORMAT " us\n", indexed_time);
+
+  g_free (linear);
+  g_free (indexed);
+
+  printf ("%s passed.\n", G_STRFUNC);
+}
+
+/* A horizontal barrier at y = position, spanning start <= x <= end */
+typedef struct
+{
+  float position;
+  float start;
+  float end;
+} TestBarrier;
+
+typedef struct
+{
+  float prev_x, prev_y;
+  float x, y;
+  int   n_candidates;
+  gboolean found;
+  float closest_t;
+} TestBarrierMotion;
+
+/* Mirrors what update_closest_barrier() in the native backend does for
+ * a candidate: find where along the motion it is crossed, if at all,
+ * and keep the earliest crossing.
+ */
+static void
+update_test_closest_barrier (gpointer barrier,
+                             gpointer user_data)
+{
+  TestBarrier *test_barrier = barrier;
+  TestBarrierMotion *motion = user_data;
+  float t, crossing_x;
+
+  motion->n_candidates++;
+
+  if (motion->y == motion->prev_y)
+    return;
+
+  t = (test_barrier->position - motion->prev_y) / (motion->y - motion->prev_y);
+  if (t < 0 || t > 1)
+    return;
+
+  crossing_x = motion->prev_x + t * (motion->x - motion->prev_x);
+  if (crossing_x < test_barrier->start || crossing_x > test_barrier->end)
+    return;
+
+  if (!motion->found || t < motion->closest_t)
+    {
+      motion->found = TRUE;
+      motion->closest_t = t;
+    }
+}
+
+static void
+linear_closest_barrier (TestBarrier       *barriers,
+                        int                n_barriers,
+                        TestBarrierMotion *motion)
+{
+  float min_position = MIN (motion->prev_y, motion->y);
+  float max_position = MAX (motion->prev_y, motion->y);
+  int i;
+
+  for (i = 0; i < n_barriers; i++)
+    {
+      /* The linear scan still only counts what the index would return */
+      if (barriers[i].position >= min_position &&
+          barriers[i].position <= max_position)
+        update_test_closest_barrier (&barriers[i], motion);
+    }
+}
+
+static void
+indexed_closest_barrier (MetaBarrierIndex  *index,
+                         TestBarrierMotion *motion)
+{
+  meta_barrier_index_foreach_in_range (index,
+                                       MIN (motion->prev_y, motion->y),
+                                       MAX (motion->prev_y, motion->y),
+                                       update_test_closest_barrier,
+                                       motion);
+}
+
+/* Pointer motions as a 1000 Hz mouse would report them: a few pixels
+ * at a time, wandering over a 4K screen.
+ */
+static void
+make_barrier_motions (TestBarrierMotion *motions,
+                      int                n_motions)
+{
+  float x = 1920, y = 1080;
+  int i;
+
+  for (i = 0; i < n_motions; i++)
+    {
+      motions[i] = (TestBarrierMotion) { .prev_x = x, .prev_y = y };
+
+      x = CLAMP (x + (rand () % 41 - 20), 0, 3839);
+      y = CLAMP (y + (rand () % 41 - 20), 0, 2159);
+
+      motions[i].x = x;
+      motions[i].y = y;
+    }
+}
+
+static void
+test_barrier_index (void)
+{
+  const int n_barriers = 48;
+  const int n_motions = 10000;
+  TestBarrier *barriers;
+  TestBarrierMotion *linear, *indexed;
+  MetaBarrierIndex *index;
+  gint64 start, linear_time, indexed_time;
+  int i;
+
+  barriers = g_new (TestBarrier, n_barriers);
+  index = meta_barrier_index_new ();
+  for (i = 0; i < n_barriers; i++)
+    {
+      barriers[i].position = rand () % 2160;
+      barriers[i].start = rand () % 3840;
+      barriers[i].end = barriers[i].start + rand () % 1000;
+      meta_barrier_index_add (index, &barriers[i], barriers[i].position);
+    }
+
+  /* A removed barrier must no longer be returned */
+  meta_barrier_index_remove (index, &barriers[n_barriers - 1]);
+
+  linear  = g_new (TestBarrierMotion, n_motions);
+  make_barrier_motions (linear, n_motions);
+  indexed = g_memdup (linear, n_motions * sizeof (TestBarrierMotion));
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_motions; i++)
+    linear_closest_barrier (barriers, n_barriers - 1, &linear[i]);
+  linear_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_motions; i++)
+    indexed_closest_barrier (index, &indexed[i]);
+  indexed_time = g_get_monotonic_time () - start;
+
+  for (i = 0; i < n_motions; i++)
+    {
+      g_assert (linear[i].n_candidates == indexed[i].n_candidates);
+      g_assert (linear[i].found == indexed[i].found);
+      g_assert (!linear[i].found ||
+                linear[i].closest_t == indexed[i].closest_t);
+    }
+
+  printf ("Finding the closest of %d barriers for %d motions:\n",
+          n_barriers - 1, n_motions);
+  printf ("  Linear scan      : %" G_GINT64_FORMAT " us\n", linear_time);
+  printf ("  Barrier index    : %" G_GINT64_FORMAT " us\n", indexed_time);
+
+  meta_barrier_index_free (index);
+  g_free (linear);
+  g_free (indexed);
+  g_free (barriers);
+
+  printf ("%s passed.\n", G_STRFUNC);
+}
+
 int
 main(void)
 {
@@ -1405,6 +1732,14 @@ main(void)
   test_gravity_resize ();
   test_find_closest_point_to_line ();
 
+  /* And finally the spatial index used for window placement, against a
+   * linear overlap scan */
+  test_rectangle_index ();
+  test_rectangle_index_benchmark ();
+
+  /* And the one used to find pointer barriers */
+  test_barrier_index ();
+
   printf ("All tests passed.\n");
   return 0;
 }
@@ -34,4 +34,21 @@ void     meta_set_syncing (gboolean setting);
 void     meta_set_replace_current_wm (gboolean setting);
 void     meta_set_is_wayland_compositor (gboolean setting);
 
+/* Laters of the types that only affect what the next frame shows
+ * (META_LATER_CALC_SHOWING and META_LATER_CHECK_FULLSCREEN) are left for
+ * a later frame once the laters run before a redraw have used up the
+ * frame budget, but never for longer than META_LATER_MAX_DEFERRAL_US.
+ * META_LATER_SYNC_STACK always runs, so that no frame shows actors in
+ * an order the window stack no longer has.
+ */
+#define META_LATER_DEFAULT_FRAME_BUDGET_US 4000
+#define META_LATER_MAX_DEFERRAL_US (50 * 1000)
+
+typedef gint64 (* MetaLaterClockFunc) (void);
+
+void     meta_later_set_frame_budget (gint64 budget_us);
+void     meta_later_set_clock        (MetaLaterClockFunc clock_func);
+void     meta_later_get_stats        (guint *n_deferred,
+                                      guint *n_overruns);
+
 #endif
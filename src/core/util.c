@@ -740,6 +740,7 @@ typedef struct
   GDestroyNotify notify;
   int source;
   gboolean run_once;
+  gint64 deadline;
 } MetaLater;
 
 static GSList *laters[] = {
@@ -750,6 +751,22 @@ static GSList *laters[] = {
   NULL, /* META_LATER_BEFORE_REDRAW */
   NULL, /* META_LATER_IDLE */
 };
+/* Whether laters of each type may be left for a later frame when running
+ * them would exceed the frame budget; see util-private.h
+ */
+static const gboolean later_deferrable[] = {
+  FALSE, /* META_LATER_RESIZE */
+  TRUE,  /* META_LATER_CALC_SHOWING */
+  TRUE,  /* META_LATER_CHECK_FULLSCREEN */
+  FALSE, /* META_LATER_SYNC_STACK */
+  FALSE, /* META_LATER_BEFORE_REDRAW */
+  FALSE, /* META_LATER_IDLE */
+};
+static gint64 later_frame_budget = META_LATER_DEFAULT_FRAME_BUDGET_US;
+static MetaLaterClockFunc later_clock = g_get_monotonic_time;
+static guint later_n_deferred = 0;
+static guint later_n_overruns = 0;
+
 /* This is a dummy timeline used to get the Clutter master clock running */
 static ClutterTimeline *later_timeline;
 static guint later_repaint_func = 0;
@@ -782,8 +799,20 @@ destroy_later (MetaLater *later)
   unref_later (later);
 }
 
+static gboolean
+later_should_defer (MetaLater *later,
+                    gint64     frame_start,
+                    gint64     now)
+{
+  return (later_deferrable[later->when] &&
+          now < later->deadline &&
+          now - frame_start >= later_frame_budget);
+}
+
 static void
-run_repaint_laters (GSList **laters_list)
+run_repaint_laters (GSList **laters_list,
+                    gint64   frame_start,
+                    guint   *n_deferred)
 {
   GSList *laters_copy;
   GSList *l;
@@ -805,8 +834,19 @@ run_repaint_laters (GSList **laters_list)
     {
       MetaLater *later = l->data;
 
-      if (!later->func || !later->func (later->data))
-        meta_later_remove_from_list (later->id, laters_list);
+      if (later->func &&
+          later_should_defer (later, frame_start, later_clock ()))
+        {
+          (*n_deferred)++;
+        }
+      else if (!later->func || !later->func (later->data))
+        {
+          meta_later_remove_from_list (later->id, laters_list);
+        }
+      else
+        {
+          later->deadline = later_clock () + META_LATER_MAX_DEFERRAL_US;
+        }
       unref_later (later);
     }
 
@@ -819,12 +859,27 @@ run_all_repaint_laters (gpointer data)
   guint i;
   GSList *l;
   gboolean keep_timeline_running = FALSE;
+  gint64 frame_start, elapsed;
+  guint n_deferred = 0;
+
+  frame_start = later_clock ();
 
   for (i = 0; i < G_N_ELEMENTS (laters); i++)
     {
-      run_repaint_laters (&laters[i]);
+      run_repaint_laters (&laters[i], frame_start, &n_deferred);
     }
 
+  elapsed = later_clock () - frame_start;
+  if (elapsed > later_frame_budget)
+    {
+      later_n_overruns++;
+      meta_topic (META_DEBUG_COMPOSITOR,
+                  "Laters took %" G_GINT64_FORMAT " us, exceeding the frame "
+                  "budget of %" G_GINT64_FORMAT " us; %u deferred\n",
+                  elapsed, later_frame_budget, n_deferred);
+    }
+  later_n_deferred += n_deferred;
+
   for (i = 0; i < G_N_ELEMENTS (laters); i++)
     {
       for (l = laters[i]; l; l = l->next)
@@ -905,6 +960,7 @@ meta_later_add (MetaLaterType  when,
   later->func = func;
   later->data = data;
   later->notify = notify;
+  later->deadline = later_clock () + META_LATER_MAX_DEFERRAL_US;
 
   laters[when] = g_slist_prepend (laters[when], later);
 
@@ -979,6 +1035,35 @@ meta_later_remove (guint later_id)
     }
 }
 
+/* Sets how much time, in microseconds, running laters before a redraw
+ * may take before deferrable laters are left for a later frame.
+ */
+void
+meta_later_set_frame_budget (gint64 budget_us)
+{
+  later_frame_budget = budget_us;
+}
+
+/* Replaces the clock frame budgets and deadlines are measured with;
+ * NULL restores g_get_monotonic_time(). For tests.
+ */
+void
+meta_later_set_clock (MetaLaterClockFunc clock_func)
+{
+  later_clock = clock_func ? clock_func : g_get_monotonic_time;
+}
+
+/* Reports how many times a later was left for a later frame, and in how
+ * many frames running laters exceeded the frame budget.
+ */
+void
+meta_later_get_stats (guint *n_deferred,
+                      guint *n_overruns)
+{
+  *n_deferred = later_n_deferred;
+  *n_overruns = later_n_overruns;
+}
+
 MetaLocaleDirection
 meta_get_locale_direction (void)
 {
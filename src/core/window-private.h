@@ -428,6 +428,14 @@ struct _MetaWindow
    */
   MetaRectangle unconstrained_rect;
 
+  /* The frame rect region within which a plain move is known to leave
+   * all constraints satisfied, as found by the last full constraint
+   * solve. Only valid while constraint_envelope_serial matches the
+   * work_area_serial of the active workspace; 0 means no envelope.
+   */
+  MetaRectangle constraint_envelope;
+  guint constraint_envelope_serial;
+
   /* The rectangle of the "server-side" geometry of the buffer,
    * in root coordinates.
    *
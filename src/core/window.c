@@ -1667,6 +1667,7 @@ idle_calc_showing (gpointer data)
   GSList *should_hide;
   GSList *unplaced;
   GSList *displays;
+  MetaScreen *screen;
   guint queue_index = GPOINTER_TO_INT (data);
 
   g_return_val_if_fail (queue_pending[queue_index] != NULL, FALSE);
@@ -1719,6 +1720,22 @@ idle_calc_showing (gpointer data)
   should_show = g_slist_sort (should_show, stackcmp);
   should_show = g_slist_reverse (should_show);
 
+  /* Apply the whole batch as one transaction: with the stack frozen,
+   * every show/hide only updates our own state, and the restack (and
+   * the compositor sync stack later it queues) happens once on thaw,
+   * rather than once per window. On a workspace switch this turns
+   * 2 * N stack syncs into one. Errors from the map/unmap requests
+   * are still handled per window, where they are made.
+   */
+  screen = ((MetaWindow *) copy->data)->screen;
+  meta_stack_freeze (screen->stack);
+
+  meta_topic (META_DEBUG_WINDOW_STATE,
+              "Batched calc_showing: %u unplaced, %u to show, %u to hide\n",
+              g_slist_length (unplaced),
+              g_slist_length (should_show),
+              g_slist_length (should_hide));
+
   tmp = unplaced;
   while (tmp != NULL)
     {
@@ -1755,6 +1772,8 @@ idle_calc_showing (gpointer data)
       tmp = tmp->next;
     }
 
+  meta_stack_thaw (screen->stack);
+
   tmp = copy;
   while (tmp != NULL)
     {
@@ -5629,11 +5648,18 @@ update_move_timeout (gpointer data)
   return FALSE;
 }
 
+/* Moves the window following the pointer at x,y. The window is placed
+ * offset_x,offset_y further along, which is used for predicting where
+ * the pointer will be when the frame is shown; tiling and shaking loose
+ * are always decided from the actual pointer position.
+ */
 static void
-update_move (MetaWindow  *window,
-             gboolean     snap,
-             int          x,
-             int          y)
+update_move_with_offset (MetaWindow  *window,
+                         gboolean     snap,
+                         int          x,
+                         int          y,
+                         int          offset_x,
+                         int          offset_y)
 {
   int dx, dy;
   int new_x, new_y;
@@ -5647,8 +5673,8 @@ update_move (MetaWindow  *window,
   dx = x - display->grab_anchor_root_x;
   dy = y - display->grab_anchor_root_y;
 
-  new_x = display->grab_anchor_window_pos.x + dx;
-  new_y = display->grab_anchor_window_pos.y + dy;
+  new_x = display->grab_anchor_window_pos.x + dx + offset_x;
+  new_y = display->grab_anchor_window_pos.y + dy + offset_y;
 
   meta_verbose ("x,y = %d,%d anchor ptr %d,%d anchor pos %d,%d dx,dy %d,%d\n",
                 x, y,
@@ -5858,6 +5884,15 @@ update_move (MetaWindow  *window,
   meta_window_move_frame (window, TRUE, new_x, new_y);
 }
 
+static void
+update_move (MetaWindow  *window,
+             gboolean     snap,
+             int          x,
+             int          y)
+{
+  update_move_with_offset (window, snap, x, y, 0, 0);
+}
+
 static gboolean
 update_resize_timeout (gpointer data)
 {
@@ -6079,6 +6114,149 @@ meta_window_update_resize (MetaWindow *window,
   update_resize (window, snap, x, y, force);
 }
 
+/* Samples further apart than this don't say anything about the current
+ * pointer velocity.
+ */
+#define GRAB_MOTION_MAX_SAMPLE_GAP_US (100 * 1000)
+/* Upper bounds on how far ahead of the pointer a prediction may go */
+#define GRAB_MOTION_MAX_LOOKAHEAD_US (25 * 1000)
+#define GRAB_MOTION_MAX_PREDICTION 48.0
+
+static gboolean
+grab_motion_frame_func (gpointer data)
+{
+  MetaWindow *window = data;
+  MetaDisplay *display = window->display;
+  gint64 now, interval, lookahead;
+  double predict_x, predict_y;
+  gboolean predicted;
+  int x, y;
+
+  if (display->grab_window != window)
+    {
+      display->grab_motion_later_id = 0;
+      return FALSE;
+    }
+
+  now = g_get_monotonic_time ();
+
+  /* Track the frame interval, so we know how far ahead to predict */
+  if (display->grab_motion_frame_time != 0)
+    {
+      interval = now - display->grab_motion_frame_time;
+      if (interval > 0 && interval < GRAB_MOTION_MAX_SAMPLE_GAP_US)
+        display->grab_motion_frame_interval =
+          (display->grab_motion_frame_interval + interval) / 2;
+    }
+  display->grab_motion_frame_time = now;
+
+  predict_x = predict_y = 0.0;
+
+  /* Extrapolate to where the pointer will be when this frame is shown.
+   * If nothing new arrived since the previous frame, the pointer has
+   * stopped; settle on the position it actually has.
+   */
+  if (display->grab_motion_n_samples > 0 && !display->grab_motion_snap)
+    {
+      lookahead = MIN (display->grab_motion_frame_interval,
+                       GRAB_MOTION_MAX_LOOKAHEAD_US);
+      predict_x = CLAMP (display->grab_motion_velocity_x * lookahead,
+                         -GRAB_MOTION_MAX_PREDICTION,
+                         GRAB_MOTION_MAX_PREDICTION);
+      predict_y = CLAMP (display->grab_motion_velocity_y * lookahead,
+                         -GRAB_MOTION_MAX_PREDICTION,
+                         GRAB_MOTION_MAX_PREDICTION);
+    }
+
+  x = (int) (display->grab_motion_x + predict_x);
+  y = (int) (display->grab_motion_y + predict_y);
+  predicted = (x != (int) display->grab_motion_x ||
+               y != (int) display->grab_motion_y);
+
+  meta_topic (META_DEBUG_RESIZING,
+              "Applying %u coalesced motion events to %s at %d,%d "
+              "(predicted %+g,%+g)\n",
+              display->grab_motion_n_samples, window->desc,
+              x, y, predict_x, predict_y);
+
+  display->grab_motion_n_samples = 0;
+
+  /* Only the window geometry follows the prediction; edge tiling and
+   * shaking loose must not trigger before the pointer gets there.
+   */
+  if (meta_grab_op_is_moving (display->grab_op))
+    update_move_with_offset (window, display->grab_motion_snap,
+                             (int) display->grab_motion_x,
+                             (int) display->grab_motion_y,
+                             x - (int) display->grab_motion_x,
+                             y - (int) display->grab_motion_y);
+  else if (meta_grab_op_is_resizing (display->grab_op))
+    update_resize (window, display->grab_motion_snap, x, y, FALSE);
+
+  /* Compensation timeouts (edge resistance, resize throttling) replay
+   * the latest motion; they should use the real pointer position.
+   */
+  display->grab_latest_motion_x = display->grab_motion_x;
+  display->grab_latest_motion_y = display->grab_motion_y;
+
+  /* The grab may have ended while updating */
+  if (display->grab_motion_later_id == 0)
+    return FALSE;
+
+  if (predicted)
+    return TRUE;
+
+  display->grab_motion_later_id = 0;
+  return FALSE;
+}
+
+/* Pointer motion can arrive much faster than we can usefully move or
+ * resize the window, and each update means a constraint run, a
+ * ConfigureWindow for X11 clients and a frame redraw. So only remember
+ * the latest position here and apply it once per stage frame.
+ */
+static void
+queue_grab_motion (MetaWindow *window,
+                   gboolean    snap,
+                   float       x,
+                   float       y)
+{
+  MetaDisplay *display = window->display;
+  gint64 now, dt;
+
+  now = g_get_monotonic_time ();
+  dt = now - display->grab_motion_sample_time;
+
+  if (display->grab_motion_sample_time == 0 ||
+      dt >= GRAB_MOTION_MAX_SAMPLE_GAP_US)
+    {
+      display->grab_motion_velocity_x = 0.0;
+      display->grab_motion_velocity_y = 0.0;
+    }
+  else if (dt > 0)
+    {
+      /* Smooth out the jitter of individual samples */
+      display->grab_motion_velocity_x =
+        (display->grab_motion_velocity_x +
+         (x - display->grab_motion_x) / (double) dt) / 2.0;
+      display->grab_motion_velocity_y =
+        (display->grab_motion_velocity_y +
+         (y - display->grab_motion_y) / (double) dt) / 2.0;
+    }
+
+  display->grab_motion_x = x;
+  display->grab_motion_y = y;
+  display->grab_motion_snap = snap;
+  display->grab_motion_sample_time = now;
+  display->grab_motion_n_samples++;
+
+  if (display->grab_motion_later_id == 0)
+    display->grab_motion_later_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                                    grab_motion_frame_func,
+                                                    window,
+                                                    NULL);
+}
+
 static void
 end_grab_op (MetaWindow *window,
              const ClutterEvent *event)
@@ -6090,6 +6268,13 @@ end_grab_op (MetaWindow *window,
   modifiers = clutter_event_get_state (event);
   meta_display_check_threshold_reached (window->display, x, y);
 
+  /* The release position is final; drop any coalesced motion */
+  if (window->display->grab_motion_later_id)
+    {
+      meta_later_remove (window->display->grab_motion_later_id);
+      window->display->grab_motion_later_id = 0;
+    }
+
   /* If the user was snap moving then ignore the button
    * release because they may have let go of shift before
    * releasing the mouse button and they almost certainly do
@@ -6100,12 +6285,15 @@ end_grab_op (MetaWindow *window,
     {
       if (meta_grab_op_is_moving (window->display->grab_op))
         {
+          /* Settle the tile mode at the release position, rather than
+           * at the last, possibly predicted, motion update.
+           */
+          update_move (window,
+                       modifiers & CLUTTER_SHIFT_MASK,
+                       x, y);
+
           if (window->tile_mode != META_TILE_NONE)
             meta_window_tile (window);
-          else
-            update_move (window,
-                         modifiers & CLUTTER_SHIFT_MASK,
-                         x, y);
         }
       else if (meta_grab_op_is_resizing (window->display->grab_op))
         {
@@ -6198,18 +6386,12 @@ meta_window_handle_mouse_grab_op_event  (MetaWindow         *window,
       clutter_event_get_coords (event, &x, &y);
 
       meta_display_check_threshold_reached (window->display, x, y);
-      if (meta_grab_op_is_moving (window->display->grab_op))
-        {
-          update_move (window,
-                       modifier_state & CLUTTER_SHIFT_MASK,
-                       x, y);
-        }
-      else if (meta_grab_op_is_resizing (window->display->grab_op))
+      if (meta_grab_op_is_moving (window->display->grab_op) ||
+          meta_grab_op_is_resizing (window->display->grab_op))
         {
-          update_resize (window,
-                         modifier_state & CLUTTER_SHIFT_MASK,
-                         x, y,
-                         FALSE);
+          queue_grab_motion (window,
+                             modifier_state & CLUTTER_SHIFT_MASK,
+                             x, y);
         }
       return TRUE;
 
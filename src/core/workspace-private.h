@@ -65,6 +65,12 @@ struct _MetaWorkspace
   GSList *all_struts;
   guint work_areas_invalid : 1;
 
+  /* Bumped every time the work areas are recomputed, so that data
+   * derived from the regions above (such as the constraint envelope
+   * of a window) can tell whether it is still current.
+   */
+  guint work_area_serial;
+
   guint showing_desktop : 1;
 };
 
@@ -77,6 +77,9 @@ enum
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Shared by all workspaces so that serials never repeat; 0 is never used */
+static guint next_work_area_serial = 0;
+
 static void
 meta_workspace_finalize (GObject *object)
 {
@@ -916,6 +919,7 @@ ensure_work_areas_validated (MetaWorkspace *workspace)
 
   /* We're all done, YAAY!  Record that everything has been validated. */
   workspace->work_areas_invalid = FALSE;
+  workspace->work_area_serial = ++next_work_area_serial;
 }
 
 static gboolean
@@ -109,11 +109,20 @@ typedef enum
 typedef void (* MetaPrefsChangedFunc) (MetaPreference pref,
                                        gpointer       user_data);
 
+typedef void (* MetaPrefsBatchChangedFunc) (const MetaPreference *prefs,
+                                            guint                 n_prefs,
+                                            gpointer              user_data);
+
 void meta_prefs_add_listener    (MetaPrefsChangedFunc func,
                                  gpointer             user_data);
 void meta_prefs_remove_listener (MetaPrefsChangedFunc func,
                                  gpointer             user_data);
 
+void meta_prefs_add_batch_listener    (MetaPrefsBatchChangedFunc func,
+                                       gpointer                  user_data);
+void meta_prefs_remove_batch_listener (MetaPrefsBatchChangedFunc func,
+                                       gpointer                  user_data);
+
 void meta_prefs_init (void);
 
 void meta_prefs_override_preference_schema (const char *key,
@@ -24,6 +24,7 @@
 #include <meta/util.h>
 
 #include "compositor/meta-plugin-manager.h"
+#include "core/util-private.h"
 
 typedef struct _MetaTestLaterOrderCallbackData
 {
@@ -173,6 +174,171 @@ meta_test_util_later_schedule_from_later (void)
   g_assert_cmpint (data.state, ==, META_TEST_LATER_FINISHED);
 }
 
+/* The budget and deadline tests drive the later clock themselves, so
+ * they don't depend on how fast the machine running them is.
+ */
+static gint64 test_later_time;
+
+static gint64
+test_later_clock (void)
+{
+  return test_later_time;
+}
+
+typedef struct _MetaTestLaterBudgetData
+{
+  GMainLoop *loop;
+  int frame;
+  guint frame_later_id;
+  int n_slow_callbacks;
+  int first_slow_frame;
+  int last_slow_frame;
+} MetaTestLaterBudgetData;
+
+#define SLOW_CALLBACK_US 2000
+#define NUM_SLOW_CALLBACKS 3
+
+static gboolean
+test_later_budget_slow_callback (gpointer user_data)
+{
+  MetaTestLaterBudgetData *data = user_data;
+
+  test_later_time += SLOW_CALLBACK_US;
+
+  if (data->n_slow_callbacks == 0)
+    data->first_slow_frame = data->frame;
+  data->last_slow_frame = data->frame;
+
+  if (++data->n_slow_callbacks == NUM_SLOW_CALLBACKS)
+    g_main_loop_quit (data->loop);
+
+  return FALSE;
+}
+
+static gboolean
+test_later_budget_frame_callback (gpointer user_data)
+{
+  MetaTestLaterBudgetData *data = user_data;
+  int i;
+
+  if (data->frame == 0)
+    {
+      for (i = 0; i < NUM_SLOW_CALLBACKS; i++)
+        meta_later_add (META_LATER_CALC_SHOWING,
+                        test_later_budget_slow_callback,
+                        data,
+                        NULL);
+    }
+
+  data->frame++;
+
+  return TRUE;
+}
+
+static void
+meta_test_util_later_budget (void)
+{
+  MetaTestLaterBudgetData data = { 0 };
+  guint n_deferred_before, n_overruns_before;
+  guint n_deferred, n_overruns;
+
+  meta_later_get_stats (&n_deferred_before, &n_overruns_before);
+
+  /* Each slow callback uses up more than the frame budget on its own,
+   * and the clock only moves when they run, so exactly one of them
+   * runs per frame.
+   */
+  test_later_time = 0;
+  meta_later_set_clock (test_later_clock);
+  meta_later_set_frame_budget (SLOW_CALLBACK_US / 2);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.frame_later_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                        test_later_budget_frame_callback,
+                                        &data,
+                                        NULL);
+
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+  meta_later_remove (data.frame_later_id);
+
+  meta_later_set_frame_budget (META_LATER_DEFAULT_FRAME_BUDGET_US);
+  meta_later_set_clock (NULL);
+
+  g_assert_cmpint (data.n_slow_callbacks, ==, NUM_SLOW_CALLBACKS);
+  g_assert_cmpint (data.last_slow_frame - data.first_slow_frame,
+                   ==, NUM_SLOW_CALLBACKS - 1);
+
+  meta_later_get_stats (&n_deferred, &n_overruns);
+  g_assert_cmpuint (n_deferred, >, n_deferred_before);
+  g_assert_cmpuint (n_overruns, >, n_overruns_before);
+}
+
+typedef struct _MetaTestLaterDeadlineData
+{
+  GMainLoop *loop;
+  guint frame_later_id;
+  gint64 queued_time;
+  gboolean ran;
+} MetaTestLaterDeadlineData;
+
+#define FRAME_INTERVAL_US 16000
+
+static gboolean
+test_later_deadline_frame_callback (gpointer user_data)
+{
+  /* Runs after the deferrable laters of the same frame */
+  test_later_time += FRAME_INTERVAL_US;
+
+  return TRUE;
+}
+
+static gboolean
+test_later_deadline_callback (gpointer user_data)
+{
+  MetaTestLaterDeadlineData *data = user_data;
+
+  g_assert_cmpint (test_later_time - data->queued_time,
+                   >=, META_LATER_MAX_DEFERRAL_US);
+  data->ran = TRUE;
+  g_main_loop_quit (data->loop);
+
+  return FALSE;
+}
+
+static void
+meta_test_util_later_deadline (void)
+{
+  MetaTestLaterDeadlineData data = { 0 };
+
+  /* Without any budget, deferrable laters only run once their deadline
+   * has passed, but they must still run.
+   */
+  test_later_time = 0;
+  meta_later_set_clock (test_later_clock);
+  meta_later_set_frame_budget (0);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.queued_time = test_later_time;
+  meta_later_add (META_LATER_CALC_SHOWING,
+                  test_later_deadline_callback,
+                  &data,
+                  NULL);
+  data.frame_later_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                        test_later_deadline_frame_callback,
+                                        &data,
+                                        NULL);
+
+  g_main_loop_run (data.loop);
+  g_main_loop_unref (data.loop);
+  meta_later_remove (data.frame_later_id);
+
+  meta_later_set_frame_budget (META_LATER_DEFAULT_FRAME_BUDGET_US);
+  meta_later_set_clock (NULL);
+
+  g_assert (data.ran);
+}
+
 static gboolean
 run_tests (gpointer data)
 {
@@ -194,6 +360,8 @@ init_tests (int argc, char **argv)
   g_test_add_func ("/util/meta-later/order", meta_test_util_later_order);
   g_test_add_func ("/util/meta-later/schedule-from-later",
                    meta_test_util_later_schedule_from_later);
+  g_test_add_func ("/util/meta-later/budget", meta_test_util_later_budget);
+  g_test_add_func ("/util/meta-later/deadline", meta_test_util_later_deadline);
 }
 
 int
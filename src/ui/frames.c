@@ -129,20 +129,35 @@ unsigned_long_hash (gconstpointer v)
 }
 
 static void
-prefs_changed_callback (MetaPreference pref,
-                        void          *data)
+prefs_changed_callback (const MetaPreference *prefs,
+                        guint                 n_prefs,
+                        gpointer              data)
 {
-  switch (pref)
+  MetaFrames *frames = META_FRAMES (data);
+  gboolean font_changed = FALSE;
+  gboolean button_layout_changed = FALSE;
+  guint i;
+
+  for (i = 0; i < n_prefs; i++)
     {
-    case META_PREF_TITLEBAR_FONT:
-      meta_frames_font_changed (META_FRAMES (data));
-      break;
-    case META_PREF_BUTTON_LAYOUT:
-      meta_frames_button_layout_changed (META_FRAMES (data));
-      break;
-    default:
-      break;
+      switch (prefs[i])
+        {
+        case META_PREF_TITLEBAR_FONT:
+          font_changed = TRUE;
+          break;
+        case META_PREF_BUTTON_LAYOUT:
+          button_layout_changed = TRUE;
+          break;
+        default:
+          break;
+        }
     }
+
+  /* A font change redraws every frame already */
+  if (font_changed)
+    meta_frames_font_changed (frames);
+  else if (button_layout_changed)
+    meta_frames_button_layout_changed (frames);
 }
 
 static void
@@ -202,7 +217,7 @@ meta_frames_init (MetaFrames *frames)
 
   update_style_contexts (frames);
 
-  meta_prefs_add_listener (prefs_changed_callback, frames);
+  meta_prefs_add_batch_listener (prefs_changed_callback, frames);
 }
 
 static void
@@ -256,7 +271,7 @@ meta_frames_finalize (GObject *object)
 
   frames = META_FRAMES (object);
 
-  meta_prefs_remove_listener (prefs_changed_callback, frames);
+  meta_prefs_remove_batch_listener (prefs_changed_callback, frames);
 
   g_hash_table_destroy (frames->text_heights);
 
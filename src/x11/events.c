@@ -35,6 +35,7 @@
 
 #include "x11/window-x11.h"
 #include "x11/xprops.h"
+#include "x11/window-props.h"
 
 #ifdef HAVE_WAYLAND
 #include "wayland/meta-xwayland.h"
@@ -1829,17 +1830,227 @@ meta_display_handle_xevent (MetaDisplay *display,
 }
 
 
+/* How far into the already queued events we look for a later event
+ * that makes the current one redundant. Bounded so that a flood of
+ * events doesn't make handling each of them linear in the queue length.
+ */
+#define EVENT_LOOKAHEAD 32
+
+static gboolean
+is_structure_event (int type)
+{
+  switch (type)
+    {
+    case CreateNotify:
+    case DestroyNotify:
+    case UnmapNotify:
+    case MapNotify:
+    case ReparentNotify:
+    case ConfigureNotify:
+    case GravityNotify:
+    case CirculateNotify:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/* Only properties whose handlers just re-read the current value can
+ * have notifies dropped. Anything counted per notify (the focus
+ * sentinel on the root window) or that carries meaning in the event
+ * itself (the timestamp of a _NET_WM_USER_TIME change) must see every
+ * one.
+ */
+static gboolean
+property_notify_is_reload (MetaDisplay    *display,
+                           XPropertyEvent *event)
+{
+  if (event->window == display->screen->xroot)
+    return FALSE;
+
+  return (event->atom == XA_WM_NAME ||
+          event->atom == display->atom__NET_WM_NAME ||
+          event->atom == display->atom__NET_WM_ICON);
+}
+
+/* Returns TRUE when "later" supersedes "event"; sets *blocked if
+ * "later" means nothing after it may be used to skip "event".
+ */
+static gboolean
+event_superseded_by (MetaDisplay *display,
+                     XEvent      *event,
+                     XEvent      *later,
+                     gboolean    *blocked)
+{
+  int damage_notify = display->damage_event_base + XDamageNotify;
+
+  *blocked = FALSE;
+
+  if (event->type == ConfigureNotify)
+    {
+      if (later->type == ConfigureNotify &&
+          later->xconfigure.event == event->xconfigure.event &&
+          later->xconfigure.window == event->xconfigure.window)
+        return TRUE;
+
+      /* Stack tracker operations are relative to siblings, so any
+       * other change to the window tree has to be replayed in order.
+       */
+      *blocked = (is_structure_event (later->type) ||
+                  later->xany.window == event->xconfigure.window);
+      return FALSE;
+    }
+  else if (event->type == PropertyNotify)
+    {
+      if (later->type == PropertyNotify &&
+          later->xproperty.window == event->xproperty.window &&
+          later->xproperty.atom == event->xproperty.atom)
+        return TRUE;
+
+      /* Anything else about the window may act on its properties */
+      *blocked = ((later->type != PropertyNotify &&
+                   later->xany.window == event->xproperty.window) ||
+                  later->type == MapRequest ||
+                  later->type == ClientMessage);
+      return FALSE;
+    }
+  else if (event->type == damage_notify)
+    {
+      XDamageNotifyEvent *damage = (XDamageNotifyEvent *) event;
+
+      if (later->type == damage_notify)
+        {
+          XDamageNotifyEvent *later_damage = (XDamageNotifyEvent *) later;
+
+          if (later_damage->damage != damage->damage)
+            return FALSE;
+
+          /* The later report must cover this one */
+          if (later_damage->area.x <= damage->area.x &&
+              later_damage->area.y <= damage->area.y &&
+              later_damage->area.x + later_damage->area.width >=
+              damage->area.x + damage->area.width &&
+              later_damage->area.y + later_damage->area.height >=
+              damage->area.y + damage->area.height)
+            return TRUE;
+
+          *blocked = TRUE;
+          return FALSE;
+        }
+
+      *blocked = (is_structure_event (later->type) &&
+                  later->xconfigure.window == damage->drawable);
+      return FALSE;
+    }
+
+  *blocked = TRUE;
+  return FALSE;
+}
+
+static gboolean
+event_is_collapsible (MetaDisplay *display,
+                      XEvent      *event)
+{
+  return (event->type == ConfigureNotify ||
+          (event->type == PropertyNotify &&
+           property_notify_is_reload (display, &event->xproperty)) ||
+          event->type == display->damage_event_base + XDamageNotify);
+}
+
+typedef struct
+{
+  MetaDisplay *display;
+  XEvent      *event;
+  int          n_left;
+  gboolean     superseded;
+} SupersedeScan;
+
+/* Called by XCheckIfEvent() for each queued event in order; never
+ * claims one, so the queue is left as it was. */
+static Bool
+scan_queued_event (Display  *xdisplay,
+                   XEvent   *queued,
+                   XPointer  data)
+{
+  SupersedeScan *scan = (SupersedeScan *) data;
+  gboolean blocked;
+
+  if (scan->n_left <= 0)
+    return False;
+
+  scan->n_left--;
+
+  if (event_superseded_by (scan->display, scan->event, queued, &blocked))
+    {
+      scan->superseded = TRUE;
+      scan->n_left = 0;
+    }
+  else if (blocked)
+    {
+      scan->n_left = 0;
+    }
+
+  return False;
+}
+
+static gboolean
+event_superseded_by_queued (MetaDisplay *display,
+                            XEvent      *event)
+{
+  SupersedeScan scan;
+  XEvent dummy;
+
+  if (!event_is_collapsible (display, event))
+    return FALSE;
+
+  /* Only look at what Xlib has already read. XCheckIfEvent() may read
+   * more when nothing matches, but anything it appends lies past the
+   * count taken here and is not looked at. */
+  scan.n_left = MIN (XEventsQueued (display->xdisplay, QueuedAlready),
+                     EVENT_LOOKAHEAD);
+  if (scan.n_left == 0)
+    return FALSE;
+
+  scan.display = display;
+  scan.event = event;
+  scan.superseded = FALSE;
+
+  XCheckIfEvent (display->xdisplay, &dummy, scan_queued_event,
+                 (XPointer) &scan);
+
+  return scan.superseded;
+}
+
 static GdkFilterReturn
 xevent_filter (GdkXEvent *xevent,
                GdkEvent  *event,
                gpointer   data)
 {
   MetaDisplay *display = data;
+  gboolean handled;
 
-  if (meta_display_handle_xevent (display, xevent))
-    return GDK_FILTER_REMOVE;
-  else
-    return GDK_FILTER_CONTINUE;
+  /* Consecutive ConfigureNotify events and name or icon PropertyNotify
+   * events for the same window and Damage reports covered by a later
+   * one are handled once, for the most recent event. The skipped event
+   * still goes to GDK.
+   */
+  if (event_superseded_by_queued (display, xevent))
+    {
+      display->n_collapsed_xevents++;
+      if (display->n_collapsed_xevents % 1000 == 0)
+        meta_topic (META_DEBUG_EVENTS, "Collapsed %u redundant X events\n",
+                    display->n_collapsed_xevents);
+      return GDK_FILTER_CONTINUE;
+    }
+
+  handled = meta_display_handle_xevent (display, xevent);
+
+  /* GDK may have read the replies to property fetches along with this
+   * event, and then the connection won't wake their source up.
+   */
+  meta_display_complete_property_reloads (display);
+
+  return handled ? GDK_FILTER_REMOVE : GDK_FILTER_CONTINUE;
 }
 
 void
@@ -29,88 +29,158 @@
 #include <cairo-xlib.h>
 #include <cairo-xlib-xrender.h>
 
+#include <string.h>
 #include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/extensions/Xrender.h>
 
-static gboolean
-find_largest_sizes (gulong *data,
-                    gulong  nitems,
-                    int    *width,
-                    int    *height)
+/* _NET_WM_ICON is a list of (width, height, pixels) entries. Apps that
+ * ship large icons easily put megabytes in there, of which we only use
+ * two sizes, so we don't read it in one go: a first request gets a
+ * chunk that normally covers the headers and pixels of all the small
+ * sizes, the headers past it are read with small requests of their own,
+ * and only then are the pixels of the two sizes we picked fetched.
+ */
+#define ICON_FIRST_CHUNK_LONGS 4096
+#define ICON_MAX_ENTRIES       64
+#define ICON_MAX_SIZE          4096
+
+typedef struct
+{
+  int      width;
+  int      height;
+  uint32_t offset; /* of the pixels, in 32-bit units */
+} IconEntry;
+
+static xcb_get_property_reply_t *
+get_net_wm_icon_range (MetaDisplay *display,
+                       Window       xwindow,
+                       uint32_t     offset,
+                       uint32_t     length)
 {
-  *width = 0;
-  *height = 0;
+  xcb_connection_t *xcb_conn = XGetXCBConnection (display->xdisplay);
+  xcb_get_property_cookie_t cookie;
+  xcb_get_property_reply_t *reply;
+  xcb_generic_error_t *error = NULL;
+
+  cookie = xcb_get_property (xcb_conn, False, xwindow,
+                             display->atom__NET_WM_ICON, XCB_ATOM_CARDINAL,
+                             offset, length);
+  reply = xcb_get_property_reply (xcb_conn, cookie, &error);
+  if (error)
+    {
+      free (error);
+      free (reply);
+      return NULL;
+    }
 
-  while (nitems > 0)
+  if (reply && (reply->type != XCB_ATOM_CARDINAL || reply->format != 32))
     {
-      int w, h;
+      free (reply);
+      return NULL;
+    }
+
+  return reply;
+}
+
+static int
+list_icon_entries (MetaDisplay              *display,
+                   Window                    xwindow,
+                   xcb_get_property_reply_t *chunk,
+                   IconEntry                *entries)
+{
+  const uint32_t *chunk_data = xcb_get_property_value (chunk);
+  uint32_t chunk_len = chunk->value_len;
+  uint64_t total = chunk_len + chunk->bytes_after / 4;
+  uint64_t pos = 0;
+  int n_entries = 0;
+
+  while (pos < total)
+    {
+      uint32_t w, h;
+
+      if (pos + 2 > total)
+        return 0; /* no space for w, h */
 
-      if (nitems < 3)
-        return FALSE; /* no space for w, h */
+      if (n_entries == ICON_MAX_ENTRIES)
+        break;
 
-      w = data[0];
-      h = data[1];
+      if (pos + 2 <= chunk_len)
+        {
+          w = chunk_data[pos];
+          h = chunk_data[pos + 1];
+        }
+      else
+        {
+          xcb_get_property_reply_t *header;
+          const uint32_t *header_data;
 
-      if (nitems < ((gulong)(w * h) + 2))
-        return FALSE; /* not enough data */
+          header = get_net_wm_icon_range (display, xwindow, pos, 2);
+          if (header == NULL || header->value_len < 2)
+            {
+              free (header);
+              return 0;
+            }
+
+          header_data = xcb_get_property_value (header);
+          w = header_data[0];
+          h = header_data[1];
+          free (header);
+        }
 
-      *width = MAX (w, *width);
-      *height = MAX (h, *height);
+      if (w == 0 || h == 0 || w > ICON_MAX_SIZE || h > ICON_MAX_SIZE)
+        return 0;
 
-      data += (w * h) + 2;
-      nitems -= (w * h) + 2;
+      if (pos + 2 + (uint64_t) w * h > total)
+        return 0; /* not enough data */
+
+      entries[n_entries].width = w;
+      entries[n_entries].height = h;
+      entries[n_entries].offset = pos + 2;
+      n_entries++;
+
+      pos += 2 + (uint64_t) w * h;
     }
 
-  return TRUE;
+  return n_entries;
 }
 
-static gboolean
-find_best_size (gulong  *data,
-                gulong   nitems,
-                int      ideal_width,
-                int      ideal_height,
-                int     *width,
-                int     *height,
-                gulong **start)
+static int
+find_best_size (IconEntry *entries,
+                int        n_entries,
+                int        ideal_width,
+                int        ideal_height)
 {
-  int best_w;
-  int best_h;
-  gulong *best_start;
-  int max_width, max_height;
+  int best;
+  int i;
 
-  *width = 0;
-  *height = 0;
-  *start = NULL;
+  if (ideal_width < 0 || ideal_height < 0)
+    {
+      int max_width = 0, max_height = 0;
 
-  if (!find_largest_sizes (data, nitems, &max_width, &max_height))
-    return FALSE;
+      for (i = 0; i < n_entries; i++)
+        {
+          max_width = MAX (entries[i].width, max_width);
+          max_height = MAX (entries[i].height, max_height);
+        }
 
-  if (ideal_width < 0)
-    ideal_width = max_width;
-  if (ideal_height < 0)
-    ideal_height = max_height;
+      if (ideal_width < 0)
+        ideal_width = max_width;
+      if (ideal_height < 0)
+        ideal_height = max_height;
+    }
 
-  best_w = 0;
-  best_h = 0;
-  best_start = NULL;
+  best = -1;
 
-  while (nitems > 0)
+  for (i = 0; i < n_entries; i++)
     {
-      int w, h;
+      int w = entries[i].width;
+      int h = entries[i].height;
       gboolean replace;
 
       replace = FALSE;
 
-      if (nitems < 3)
-        return FALSE; /* no space for w, h */
-
-      w = data[0];
-      h = data[1];
-
-      if (nitems < ((gulong)(w * h) + 2))
-        break; /* not enough data */
-
-      if (best_start == NULL)
+      if (best < 0)
         {
           replace = TRUE;
         }
@@ -118,7 +188,7 @@ find_best_size (gulong  *data,
         {
           /* work with averages */
           const int ideal_size = (ideal_width + ideal_height) / 2;
-          int best_size = (best_w + best_h) / 2;
+          int best_size = (entries[best].width + entries[best].height) / 2;
           int this_size = (w + h) / 2;
 
           /* larger than desired is always better than smaller */
@@ -139,54 +209,162 @@ find_best_size (gulong  *data,
         }
 
       if (replace)
-        {
-          best_start = data + 2;
-          best_w = w;
-          best_h = h;
-        }
-
-      data += (w * h) + 2;
-      nitems -= (w * h) + 2;
+        best = i;
     }
 
-  if (best_start)
+  return best;
+}
+
+/* Icon surfaces are shared between all windows whose icon has the same
+ * pixels, which is the common case for windows of the same WM_CLASS.
+ * The table doesn't hold references; an entry goes away with the last
+ * window using its surface.
+ */
+typedef struct
+{
+  guint            hash;
+  int              width;
+  int              height;
+  cairo_surface_t *surface;
+} IconSurfaceKey;
+
+static GHashTable *icon_surfaces = NULL;
+static cairo_user_data_key_t icon_surface_key;
+
+static guint
+icon_surface_key_hash (gconstpointer data)
+{
+  const IconSurfaceKey *key = data;
+
+  return key->hash ^ (key->width << 16) ^ key->height;
+}
+
+static gboolean
+icon_surface_key_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const IconSurfaceKey *key_a = a;
+  const IconSurfaceKey *key_b = b;
+
+  return (key_a->hash == key_b->hash &&
+          key_a->width == key_b->width &&
+          key_a->height == key_b->height);
+}
+
+static void
+icon_surface_destroyed (void *data)
+{
+  IconSurfaceKey *key = data;
+
+  g_hash_table_remove (icon_surfaces, key);
+  g_free (key);
+}
+
+static guint
+hash_argb_data (const uint32_t *argb_data,
+                gsize           n_pixels)
+{
+  guint hash = 2166136261u; /* FNV-1a */
+  gsize i;
+
+  for (i = 0; i < n_pixels; i++)
+    hash = (hash ^ argb_data[i]) * 16777619u;
+
+  return hash;
+}
+
+static gboolean
+surface_has_argb_data (cairo_surface_t *surface,
+                       const uint32_t  *argb_data,
+                       int              w,
+                       int              h)
+{
+  const guchar *data = cairo_image_surface_get_data (surface);
+  int stride = cairo_image_surface_get_stride (surface);
+  int y;
+
+  for (y = 0; y < h; y++)
     {
-      *start = best_start;
-      *width = best_w;
-      *height = best_h;
-      return TRUE;
+      if (memcmp (data + y * stride, argb_data + y * w,
+                  w * sizeof (uint32_t)) != 0)
+        return FALSE;
     }
-  else
-    return FALSE;
+
+  return TRUE;
 }
 
 static cairo_surface_t *
-argbdata_to_surface (gulong *argb_data, int w, int h)
+argbdata_to_surface (const uint32_t *argb_data, int w, int h)
 {
   cairo_surface_t *surface;
-  int y, x, stride;
-  uint32_t *data;
+  IconSurfaceKey lookup, *key;
+  guchar *data;
+  int y, stride;
+
+  lookup.hash = hash_argb_data (argb_data, (gsize) w * h);
+  lookup.width = w;
+  lookup.height = h;
+
+  if (icon_surfaces == NULL)
+    icon_surfaces = g_hash_table_new (icon_surface_key_hash,
+                                      icon_surface_key_equal);
+
+  key = g_hash_table_lookup (icon_surfaces, &lookup);
+  if (key && surface_has_argb_data (key->surface, argb_data, w, h))
+    return cairo_surface_reference (key->surface);
 
   surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
-  stride = cairo_image_surface_get_stride (surface) / sizeof (uint32_t);
-  data = (uint32_t *) cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  data = cairo_image_surface_get_data (surface);
 
-  /* One could speed this up a lot. */
-  for (y = 0; y < h; y++)
+  /* xcb hands us the property as 32-bit values, which already is
+   * CAIRO_FORMAT_ARGB32, so this is a plain copy.
+   */
+  if (stride == w * (int) sizeof (uint32_t))
     {
-      for (x = 0; x < w; x++)
-        {
-          uint32_t *p = &data[y * stride + x];
-          gulong *d = &argb_data[y * w + x];
-          *p = *d;
-        }
+      memcpy (data, argb_data, (gsize) h * stride);
+    }
+  else
+    {
+      for (y = 0; y < h; y++)
+        memcpy (data + y * stride, argb_data + y * w,
+                w * sizeof (uint32_t));
     }
 
   cairo_surface_mark_dirty (surface);
 
+  /* On a hash collision the surface just isn't shared */
+  if (key == NULL)
+    {
+      key = g_memdup (&lookup, sizeof (lookup));
+      key->surface = surface;
+      g_hash_table_add (icon_surfaces, key);
+      cairo_surface_set_user_data (surface, &icon_surface_key,
+                                   key, icon_surface_destroyed);
+    }
+
   return surface;
 }
 
+static const uint32_t *
+icon_entry_data (xcb_get_property_reply_t  *chunk,
+                 xcb_get_property_reply_t  *fetched,
+                 IconEntry                 *entry)
+{
+  if (fetched)
+    return xcb_get_property_value (fetched);
+  else
+    return (const uint32_t *) xcb_get_property_value (chunk) + entry->offset;
+}
+
+static gboolean
+icon_entry_in_chunk (xcb_get_property_reply_t *chunk,
+                     IconEntry                *entry)
+{
+  return ((uint64_t) entry->offset +
+          (uint64_t) entry->width * entry->height <= chunk->value_len);
+}
+
 static gboolean
 read_rgb_icon (MetaDisplay      *display,
                Window            xwindow,
@@ -197,63 +375,91 @@ read_rgb_icon (MetaDisplay      *display,
                cairo_surface_t **icon,
                cairo_surface_t **mini_icon)
 {
-  Atom type;
-  int format;
-  gulong nitems;
-  gulong bytes_after;
-  int result, err;
-  guchar *data;
-  gulong *best;
-  int w, h;
-  gulong *best_mini;
-  int mini_w, mini_h;
-  gulong *data_as_long;
-
-  meta_error_trap_push (display);
-  type = None;
-  data = NULL;
-  result = XGetWindowProperty (display->xdisplay,
-			       xwindow,
-                               display->atom__NET_WM_ICON,
-			       0, G_MAXLONG,
-			       False, XA_CARDINAL, &type, &format, &nitems,
-			       &bytes_after, &data);
-  err = meta_error_trap_pop_with_return (display);
-
-  if (err != Success ||
-      result != Success)
+  xcb_connection_t *xcb_conn = XGetXCBConnection (display->xdisplay);
+  xcb_get_property_reply_t *chunk;
+  xcb_get_property_reply_t *replies[2] = { NULL, NULL };
+  xcb_get_property_cookie_t cookies[2];
+  IconEntry entries[ICON_MAX_ENTRIES];
+  int n_entries;
+  int best[2];
+  gboolean fetch[2];
+  gboolean ok = TRUE;
+  int i;
+
+  chunk = get_net_wm_icon_range (display, xwindow, 0, ICON_FIRST_CHUNK_LONGS);
+  if (chunk == NULL)
     return FALSE;
 
-  if (type != XA_CARDINAL)
+  n_entries = list_icon_entries (display, xwindow, chunk, entries);
+  if (n_entries == 0)
     {
-      XFree (data);
+      free (chunk);
       return FALSE;
     }
 
-  data_as_long = (gulong *)data;
+  best[0] = find_best_size (entries, n_entries, ideal_width, ideal_height);
+  best[1] = find_best_size (entries, n_entries,
+                            ideal_mini_width, ideal_mini_height);
 
-  if (!find_best_size (data_as_long, nitems,
-                       ideal_width, ideal_height,
-                       &w, &h, &best))
+  /* Send both pixel requests before waiting for either */
+  for (i = 0; i < 2; i++)
     {
-      XFree (data);
-      return FALSE;
+      IconEntry *entry = &entries[best[i]];
+
+      fetch[i] = !icon_entry_in_chunk (chunk, entry) &&
+                 !(i == 1 && best[1] == best[0]);
+      if (fetch[i])
+        cookies[i] = xcb_get_property (xcb_conn, False, xwindow,
+                                       display->atom__NET_WM_ICON,
+                                       XCB_ATOM_CARDINAL,
+                                       entry->offset,
+                                       entry->width * entry->height);
     }
 
-  if (!find_best_size (data_as_long, nitems,
-                       ideal_mini_width, ideal_mini_height,
-                       &mini_w, &mini_h, &best_mini))
+  for (i = 0; i < 2; i++)
     {
-      XFree (data);
-      return FALSE;
+      IconEntry *entry = &entries[best[i]];
+      xcb_generic_error_t *error = NULL;
+
+      if (!fetch[i])
+        continue;
+
+      replies[i] = xcb_get_property_reply (xcb_conn, cookies[i], &error);
+      if (error)
+        {
+          free (error);
+          ok = FALSE;
+        }
+      else if (replies[i] == NULL ||
+               replies[i]->type != XCB_ATOM_CARDINAL ||
+               replies[i]->format != 32 ||
+               replies[i]->value_len <
+                 (uint32_t) (entry->width * entry->height))
+        ok = FALSE;
     }
 
-  *icon = argbdata_to_surface (best, w, h);
-  *mini_icon = argbdata_to_surface (best_mini, mini_w, mini_h);
+  if (ok)
+    {
+      xcb_get_property_reply_t *mini_reply = replies[1];
+
+      if (best[1] == best[0] && !fetch[1])
+        mini_reply = replies[0];
+
+      *icon = argbdata_to_surface (icon_entry_data (chunk, replies[0],
+                                                    &entries[best[0]]),
+                                   entries[best[0]].width,
+                                   entries[best[0]].height);
+      *mini_icon = argbdata_to_surface (icon_entry_data (chunk, mini_reply,
+                                                         &entries[best[1]]),
+                                        entries[best[1]].width,
+                                        entries[best[1]].height);
+    }
 
-  XFree (data);
+  free (replies[0]);
+  free (replies[1]);
+  free (chunk);
 
-  return TRUE;
+  return ok;
 }
 
 static void
@@ -1061,7 +1061,70 @@ static GMarkupParser mutter_session_parser = {
   NULL
 };
 
-static GSList *window_info_list = NULL;
+/* Saved window infos, indexed by the properties a window has to match
+ * exactly (see session_info_key()); each entry is a GQueue of infos in
+ * the order they appeared in the session file.
+ */
+static GHashTable *window_info_index = NULL;
+
+static char*
+session_info_key (const char *id,
+                  const char *res_class,
+                  const char *res_name,
+                  const char *role)
+{
+  const char *fields[4];
+  GString *key;
+  int i;
+
+  /* Ignore the client ID if we're debugging */
+  fields[0] = g_getenv ("MUTTER_DEBUG_SM") != NULL ? NULL : id;
+  fields[1] = res_class;
+  fields[2] = res_name;
+  fields[3] = role;
+
+  /* Length-prefix each field so that NULL, "" and embedded separators
+   * all stay distinct.
+   */
+  key = g_string_new (NULL);
+  for (i = 0; i < 4; i++)
+    {
+      if (fields[i])
+        g_string_append_printf (key, "%zu:%s", strlen (fields[i]), fields[i]);
+      else
+        g_string_append_c (key, '-');
+    }
+
+  return g_string_free (key, FALSE);
+}
+
+static void
+index_session_info (MetaWindowSessionInfo *info)
+{
+  char *key;
+  GQueue *infos;
+
+  if (window_info_index == NULL)
+    window_info_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) g_queue_free);
+
+  key = session_info_key (info->id, info->res_class,
+                          info->res_name, info->role);
+
+  infos = g_hash_table_lookup (window_info_index, key);
+  if (infos == NULL)
+    {
+      infos = g_queue_new ();
+      g_hash_table_insert (window_info_index, key, infos);
+    }
+  else
+    {
+      g_free (key);
+    }
+
+  g_queue_push_tail (infos, info);
+}
 
 static char*
 load_state (const char *previous_save_file)
@@ -1480,8 +1543,7 @@ end_element_handler    (GMarkupParseContext *context,
     {
       g_assert (pd->info);
 
-      window_info_list = g_slist_prepend (window_info_list,
-                                          pd->info);
+      index_session_info (pd->info);
 
       meta_topic (META_DEBUG_SM, "Loaded window info from session with class: %s name: %s role: %s\n",
                   pd->info->res_class ? pd->info->res_class : "(none)",
@@ -1516,88 +1578,43 @@ both_null_or_matching (const char *a,
     return FALSE;
 }
 
-static GSList*
+static GQueue*
 get_possible_matches (MetaWindow *window)
 {
-  /* Get all windows with this client ID */
-  GSList *retval;
-  GSList *tmp;
-  gboolean ignore_client_id;
-
-  retval = NULL;
-
-  ignore_client_id = g_getenv ("MUTTER_DEBUG_SM") != NULL;
-
-  tmp = window_info_list;
-  while (tmp != NULL)
-    {
-      MetaWindowSessionInfo *info;
-
-      info = tmp->data;
-
-      if ((ignore_client_id ||
-           both_null_or_matching (info->id, window->sm_client_id)) &&
-          both_null_or_matching (info->res_class, window->res_class) &&
-          both_null_or_matching (info->res_name, window->res_name) &&
-          both_null_or_matching (info->role, window->role))
-        {
-          meta_topic (META_DEBUG_SM, "Window %s may match saved window with class: %s name: %s role: %s\n",
-                      window->desc,
-                      info->res_class ? info->res_class : "(none)",
-                      info->res_name ? info->res_name : "(none)",
-                      info->role ? info->role : "(none)");
-
-          retval = g_slist_prepend (retval, info);
-        }
-      else
-        {
-          if (meta_is_verbose ())
-            {
-              if (!both_null_or_matching (info->id, window->sm_client_id))
-                meta_topic (META_DEBUG_SM, "Window %s has SM client ID %s, saved state has %s, no match\n",
-                            window->desc,
-                            window->sm_client_id ? window->sm_client_id : "(none)",
-                            info->id ? info->id : "(none)");
-              else if (!both_null_or_matching (info->res_class, window->res_class))
-                meta_topic (META_DEBUG_SM, "Window %s has class %s doesn't match saved class %s, no match\n",
-                            window->desc,
-                            window->res_class ? window->res_class : "(none)",
-                            info->res_class ? info->res_class : "(none)");
-
-              else if (!both_null_or_matching (info->res_name, window->res_name))
-                meta_topic (META_DEBUG_SM, "Window %s has name %s doesn't match saved name %s, no match\n",
-                            window->desc,
-                            window->res_name ? window->res_name : "(none)",
-                            info->res_name ? info->res_name : "(none)");
-              else if (!both_null_or_matching (info->role, window->role))
-                meta_topic (META_DEBUG_SM, "Window %s has role %s doesn't match saved role %s, no match\n",
-                            window->desc,
-                            window->role ? window->role : "(none)",
-                            info->role ? info->role : "(none)");
-              else
-                meta_topic (META_DEBUG_SM, "???? should not happen - window %s doesn't match saved state %s for no good reason\n",
-                            window->desc, info->id);
-            }
-        }
-
-      tmp = tmp->next;
-    }
-
-  return retval;
+  /* Get all windows with this client ID, class, name and role */
+  GQueue *infos;
+  char *key;
+
+  if (window_info_index == NULL)
+    return NULL;
+
+  key = session_info_key (window->sm_client_id, window->res_class,
+                          window->res_name, window->role);
+  infos = g_hash_table_lookup (window_info_index, key);
+  g_free (key);
+
+  if (infos)
+    meta_topic (META_DEBUG_SM, "Window %s may match %u saved window(s) with class: %s name: %s role: %s\n",
+                window->desc, infos->length,
+                window->res_class ? window->res_class : "(none)",
+                window->res_name ? window->res_name : "(none)",
+                window->role ? window->role : "(none)");
+
+  return infos;
 }
 
 static const MetaWindowSessionInfo*
-find_best_match (GSList     *infos,
+find_best_match (GQueue     *infos,
                  MetaWindow *window)
 {
-  GSList *tmp;
+  GList *tmp;
   const MetaWindowSessionInfo *matching_title;
   const MetaWindowSessionInfo *matching_type;
 
   matching_title = NULL;
   matching_type = NULL;
 
-  tmp = infos;
+  tmp = infos->head;
   while (tmp != NULL)
     {
       MetaWindowSessionInfo *info;
@@ -1626,14 +1643,13 @@ find_best_match (GSList     *infos,
   else if (matching_type)
     return matching_type;
   else
-    return infos->data;
+    return infos->head->data;
 }
 
 const MetaWindowSessionInfo*
 meta_window_lookup_saved_state (MetaWindow *window)
 {
-  GSList *possibles;
-  const MetaWindowSessionInfo *info;
+  GQueue *possibles;
 
   /* Window is not session managed.
    * I haven't yet figured out how to deal with these
@@ -1657,20 +1673,28 @@ meta_window_lookup_saved_state (MetaWindow *window)
       return NULL;
     }
 
-  info = find_best_match (possibles, window);
-
-  g_slist_free (possibles);
-
-  return info;
+  return find_best_match (possibles, window);
 }
 
 void
 meta_window_release_saved_state (const MetaWindowSessionInfo *info)
 {
+  char *key;
+  GQueue *infos;
+
   /* We don't want to use the same saved state again for another
    * window.
    */
-  window_info_list = g_slist_remove (window_info_list, info);
+  key = session_info_key (info->id, info->res_class,
+                          info->res_name, info->role);
+  infos = g_hash_table_lookup (window_info_index, key);
+  if (infos)
+    {
+      g_queue_remove (infos, info);
+      if (g_queue_is_empty (infos))
+        g_hash_table_remove (window_info_index, key);
+    }
+  g_free (key);
 
   session_info_free ((MetaWindowSessionInfo*) info);
 }
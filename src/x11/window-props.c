@@ -47,6 +47,7 @@
 #include "frame.h"
 #include <meta/group.h>
 #include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
 #include <unistd.h>
 #include <string.h>
 #include "util-private.h"
@@ -66,6 +67,10 @@ typedef enum {
   INCLUDE_OR = (1 << 1),
   INIT_ONLY  = (1 << 2),
   FORCE_INIT = (1 << 3),
+  /* Reload on PropertyNotify without waiting for the reply, see
+   * meta_window_queue_property_reload()
+   */
+  ASYNC      = (1 << 4),
 } MetaPropHookFlags;
 
 struct _MetaWindowPropHooks
@@ -85,6 +90,9 @@ static void reload_prop_value          (MetaWindow          *window,
                                         gboolean             initial);
 static MetaWindowPropHooks* find_hooks (MetaDisplay *display,
                                         Atom         property);
+static void cancel_property_fetch      (MetaDisplay *display,
+                                        Window       xwindow,
+                                        Atom         property);
 
 
 void
@@ -105,6 +113,11 @@ meta_window_reload_property_from_xwindow (MetaWindow      *window,
 
   init_prop_value (window, hooks, &value);
 
+  /* Whatever an outstanding asynchronous fetch would return is older
+   * than what we're about to get.
+   */
+  cancel_property_fetch (window->display, xwindow, property);
+
   meta_prop_get_values (window->display, xwindow,
                         &value, 1);
 
@@ -125,29 +138,263 @@ meta_window_reload_property (MetaWindow      *window,
                                             initial);
 }
 
+/* Properties flagged ASYNC are fetched without blocking: the
+ * GetProperty request goes out when the PropertyNotify is handled, and
+ * the reload hook runs once the reply is in, from a GSource watching
+ * the X connection or from the X event filter if GDK read it first. There is at most one fetch in flight per (xwindow,
+ * atom); notifies arriving meanwhile just ask for one more fetch when
+ * it completes, so a client rewriting its title on every frame costs
+ * us one outstanding request and never a round trip.
+ *
+ * Fetches complete in the order they were requested, which is the
+ * order the server answers them in.
+ */
+typedef struct
+{
+  MetaWindow      *window;
+  Window           xwindow;
+  Atom             property;
+  MetaPropValue    value;
+  MetaPropRequest *request;
+  gboolean         refetch;
+} MetaPropFetch;
+
+typedef struct
+{
+  GSource      base;
+  GPollFD      poll_fd;
+  MetaDisplay *display;
+  GQueue       fetches;
+  gboolean     needs_flush;
+} MetaPropFetchSource;
+
+static MetaPropFetch *
+find_property_fetch (MetaPropFetchSource *fetch_source,
+                     Window               xwindow,
+                     Atom                 property)
+{
+  GList *l;
+
+  /* Coalescing keeps this queue a handful of entries long */
+  for (l = fetch_source->fetches.head; l; l = l->next)
+    {
+      MetaPropFetch *fetch = l->data;
+
+      if (fetch->xwindow == xwindow && fetch->property == property)
+        return fetch;
+    }
+
+  return NULL;
+}
+
+static void
+property_fetch_free (MetaPropFetch *fetch)
+{
+  if (fetch->request)
+    meta_prop_cancel_values (fetch->request);
+
+  meta_prop_free_values (&fetch->value, 1);
+  g_free (fetch);
+}
+
+static void
+queue_property_fetch (MetaWindow          *window,
+                      Window               xwindow,
+                      MetaWindowPropHooks *hooks)
+{
+  MetaPropFetchSource *fetch_source =
+    (MetaPropFetchSource *) window->display->prop_fetch_source;
+  MetaPropFetch *fetch;
+
+  fetch = find_property_fetch (fetch_source, xwindow, hooks->property);
+  if (fetch)
+    {
+      meta_verbose ("Coalescing property notify on %s\n", window->desc);
+      fetch->refetch = TRUE;
+      return;
+    }
+
+  fetch = g_new0 (MetaPropFetch, 1);
+  fetch->window = window;
+  fetch->xwindow = xwindow;
+  fetch->property = hooks->property;
+  init_prop_value (window, hooks, &fetch->value);
+  fetch->request = meta_prop_request_values (window->display, xwindow,
+                                             &fetch->value, 1);
+
+  g_queue_push_tail (&fetch_source->fetches, fetch);
+  fetch_source->needs_flush = TRUE;
+}
+
+static void
+cancel_property_fetch (MetaDisplay *display,
+                       Window       xwindow,
+                       Atom         property)
+{
+  MetaPropFetchSource *fetch_source =
+    (MetaPropFetchSource *) display->prop_fetch_source;
+  MetaPropFetch *fetch;
+
+  if (fetch_source == NULL)
+    return;
+
+  fetch = find_property_fetch (fetch_source, xwindow, property);
+  if (fetch)
+    {
+      g_queue_remove (&fetch_source->fetches, fetch);
+      property_fetch_free (fetch);
+    }
+}
+
+static void
+complete_property_fetch (MetaPropFetchSource *fetch_source)
+{
+  MetaPropFetch *fetch = g_queue_pop_head (&fetch_source->fetches);
+  MetaWindowPropHooks *hooks;
+
+  meta_prop_finish_values (fetch->request);
+  fetch->request = NULL;
+
+  hooks = find_hooks (fetch_source->display, fetch->property);
+  reload_prop_value (fetch->window, hooks, &fetch->value, FALSE);
+
+  if (fetch->refetch)
+    queue_property_fetch (fetch->window, fetch->xwindow, hooks);
+
+  property_fetch_free (fetch);
+}
+
+static gboolean
+property_fetch_ready (MetaPropFetchSource *fetch_source)
+{
+  MetaPropFetch *fetch = g_queue_peek_head (&fetch_source->fetches);
+
+  return fetch != NULL && meta_prop_poll_values (fetch->request);
+}
+
+/* Neither prepare nor check may touch the X socket: GDK's X source
+ * decides whether to sleep by asking Xlib what it has already read, and
+ * anything we pulled off the connection there would sit in xcb's queue
+ * while poll() waits on a drained fd. All reading (and flushing, which
+ * reads too when the server pushes back) happens from dispatch; GDK's
+ * next prepare picks up whatever events that queued behind it.
+ *
+ * Replies that GDK reads while fetching events don't wake us; those
+ * are completed from the event filter, right after the event they came
+ * in with, see meta_display_complete_property_reloads().
+ */
+static gboolean
+prop_fetch_source_prepare (GSource *source,
+                           int     *timeout)
+{
+  MetaPropFetchSource *fetch_source = (MetaPropFetchSource *) source;
+
+  *timeout = -1;
+
+  return fetch_source->needs_flush;
+}
+
+static gboolean
+prop_fetch_source_check (GSource *source)
+{
+  MetaPropFetchSource *fetch_source = (MetaPropFetchSource *) source;
+
+  if (fetch_source->needs_flush)
+    return TRUE;
+
+  return (!g_queue_is_empty (&fetch_source->fetches) &&
+          (fetch_source->poll_fd.revents & G_IO_IN) != 0);
+}
+
+static gboolean
+prop_fetch_source_dispatch (GSource     *source,
+                            GSourceFunc  callback,
+                            gpointer     user_data)
+{
+  MetaPropFetchSource *fetch_source = (MetaPropFetchSource *) source;
+
+  if (fetch_source->needs_flush)
+    {
+      xcb_flush (XGetXCBConnection (fetch_source->display->xdisplay));
+      fetch_source->needs_flush = FALSE;
+    }
+
+  while (property_fetch_ready (fetch_source))
+    complete_property_fetch (fetch_source);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs prop_fetch_source_funcs = {
+  prop_fetch_source_prepare,
+  prop_fetch_source_check,
+  prop_fetch_source_dispatch,
+};
+
 void
-meta_window_load_initial_properties (MetaWindow *window)
+meta_window_queue_property_reload (MetaWindow *window,
+                                   Window      xwindow,
+                                   Atom        property)
 {
-  int i, j;
-  MetaPropValue *values;
-  int n_properties = 0;
+  MetaWindowPropHooks *hooks;
 
-  values = g_new0 (MetaPropValue, window->display->n_prop_hooks);
+  hooks = find_hooks (window->display, property);
 
-  j = 0;
-  for (i = 0; i < window->display->n_prop_hooks; i++)
+  if (hooks && (hooks->flags & ASYNC) &&
+      !(window->override_redirect && !(hooks->flags & INCLUDE_OR)))
+    queue_property_fetch (window, xwindow, hooks);
+  else
+    meta_window_reload_property_from_xwindow (window, xwindow,
+                                              property, FALSE);
+}
+
+void
+meta_window_cancel_property_reloads (MetaWindow *window)
+{
+  MetaPropFetchSource *fetch_source =
+    (MetaPropFetchSource *) window->display->prop_fetch_source;
+  GList *l, *next;
+
+  for (l = fetch_source->fetches.head; l; l = next)
     {
-      MetaWindowPropHooks *hooks = &window->display->prop_hooks_table[i];
-      if (hooks->flags & LOAD_INIT)
+      MetaPropFetch *fetch = l->data;
+
+      next = l->next;
+      if (fetch->window == window)
         {
-          init_prop_value (window, hooks, &values[j]);
-          ++j;
+          g_queue_delete_link (&fetch_source->fetches, l);
+          property_fetch_free (fetch);
         }
     }
-  n_properties = j;
+}
 
-  meta_prop_get_values (window->display, window->xwindow,
-                        values, n_properties);
+void
+meta_display_complete_property_reloads (MetaDisplay *display)
+{
+  MetaPropFetchSource *fetch_source =
+    (MetaPropFetchSource *) display->prop_fetch_source;
+
+  /* Requests still waiting for a flush can't have been answered */
+  if (fetch_source->needs_flush)
+    return;
+
+  while (property_fetch_ready (fetch_source))
+    complete_property_fetch (fetch_source);
+}
+
+struct _MetaWindowPropPrefetch
+{
+  Window           xwindow;
+  MetaPropValue   *values;
+  int              n_values;
+  MetaPropRequest *request;
+};
+
+static void
+load_initial_prop_values (MetaWindow    *window,
+                          MetaPropValue *values)
+{
+  int i, j;
 
   j = 0;
   for (i = 0; i < window->display->n_prop_hooks; i++)
@@ -165,6 +412,100 @@ meta_window_load_initial_properties (MetaWindow *window)
           ++j;
         }
     }
+}
+
+MetaWindowPropPrefetch *
+meta_window_prefetch_initial_properties (MetaDisplay *display,
+                                         Window       xwindow,
+                                         gboolean     override_redirect)
+{
+  MetaWindowPropPrefetch *prefetch;
+  int i, j;
+
+  prefetch = g_new0 (MetaWindowPropPrefetch, 1);
+  prefetch->xwindow = xwindow;
+  prefetch->values = g_new0 (MetaPropValue, display->n_prop_hooks);
+
+  /* Same as init_prop_value(), but we don't have a window yet */
+  j = 0;
+  for (i = 0; i < display->n_prop_hooks; i++)
+    {
+      MetaWindowPropHooks *hooks = &display->prop_hooks_table[i];
+      if (hooks->flags & LOAD_INIT)
+        {
+          if (hooks->type == META_PROP_VALUE_INVALID ||
+              (override_redirect && !(hooks->flags & INCLUDE_OR)))
+            {
+              prefetch->values[j].type = META_PROP_VALUE_INVALID;
+              prefetch->values[j].atom = None;
+            }
+          else
+            {
+              prefetch->values[j].type = hooks->type;
+              prefetch->values[j].atom = hooks->property;
+            }
+          ++j;
+        }
+    }
+  prefetch->n_values = j;
+
+  prefetch->request = meta_prop_request_values (display, xwindow,
+                                                prefetch->values,
+                                                prefetch->n_values);
+
+  return prefetch;
+}
+
+void
+meta_window_prefetch_free (MetaWindowPropPrefetch *prefetch)
+{
+  if (prefetch->request)
+    meta_prop_cancel_values (prefetch->request);
+
+  meta_prop_free_values (prefetch->values, prefetch->n_values);
+  g_free (prefetch->values);
+  g_free (prefetch);
+}
+
+void
+meta_window_load_prefetched_properties (MetaWindow             *window,
+                                        MetaWindowPropPrefetch *prefetch)
+{
+  g_return_if_fail (prefetch->xwindow == window->xwindow);
+
+  meta_prop_finish_values (prefetch->request);
+  prefetch->request = NULL;
+
+  load_initial_prop_values (window, prefetch->values);
+
+  meta_window_prefetch_free (prefetch);
+}
+
+void
+meta_window_load_initial_properties (MetaWindow *window)
+{
+  int i, j;
+  MetaPropValue *values;
+  int n_properties = 0;
+
+  values = g_new0 (MetaPropValue, window->display->n_prop_hooks);
+
+  j = 0;
+  for (i = 0; i < window->display->n_prop_hooks; i++)
+    {
+      MetaWindowPropHooks *hooks = &window->display->prop_hooks_table[i];
+      if (hooks->flags & LOAD_INIT)
+        {
+          init_prop_value (window, hooks, &values[j]);
+          ++j;
+        }
+    }
+  n_properties = j;
+
+  meta_prop_get_values (window->display, window->xwindow,
+                        values, n_properties);
+
+  load_initial_prop_values (window, values);
 
   meta_prop_free_values (values, n_properties);
 
@@ -2317,12 +2658,12 @@ meta_display_init_window_prop_hooks (MetaDisplay *display)
    */
   MetaWindowPropHooks hooks[] = {
     { display->atom_WM_CLIENT_MACHINE, META_PROP_VALUE_STRING,   reload_wm_client_machine, LOAD_INIT | INCLUDE_OR },
-    { display->atom__NET_WM_NAME,      META_PROP_VALUE_UTF8,     reload_net_wm_name,       LOAD_INIT | INCLUDE_OR },
+    { display->atom__NET_WM_NAME,      META_PROP_VALUE_UTF8,     reload_net_wm_name,       LOAD_INIT | INCLUDE_OR | ASYNC },
     { XA_WM_CLASS,                     META_PROP_VALUE_CLASS_HINT, reload_wm_class,        LOAD_INIT | INCLUDE_OR },
     { display->atom__NET_WM_PID,       META_PROP_VALUE_CARDINAL, reload_net_wm_pid,        LOAD_INIT | INCLUDE_OR },
-    { XA_WM_NAME,                      META_PROP_VALUE_TEXT_PROPERTY, reload_wm_name,      LOAD_INIT | INCLUDE_OR },
+    { XA_WM_NAME,                      META_PROP_VALUE_TEXT_PROPERTY, reload_wm_name,      LOAD_INIT | INCLUDE_OR | ASYNC },
     { display->atom__MUTTER_HINTS,     META_PROP_VALUE_TEXT_PROPERTY, reload_mutter_hints, LOAD_INIT | INCLUDE_OR },
-    { display->atom__NET_WM_OPAQUE_REGION, META_PROP_VALUE_CARDINAL_LIST, reload_opaque_region, LOAD_INIT | INCLUDE_OR },
+    { display->atom__NET_WM_OPAQUE_REGION, META_PROP_VALUE_CARDINAL_LIST, reload_opaque_region, LOAD_INIT | INCLUDE_OR | ASYNC },
     { display->atom__NET_WM_DESKTOP,   META_PROP_VALUE_CARDINAL, reload_net_wm_desktop,    LOAD_INIT | INIT_ONLY },
     { display->atom__NET_STARTUP_ID,   META_PROP_VALUE_UTF8,     reload_net_startup_id,    LOAD_INIT },
     { display->atom__NET_WM_SYNC_REQUEST_COUNTER, META_PROP_VALUE_SYNC_COUNTER_LIST, reload_update_counter, LOAD_INIT | INCLUDE_OR },
@@ -2350,7 +2691,7 @@ meta_display_init_window_prop_hooks (MetaDisplay *display)
     { display->atom__NET_WM_USER_TIME_WINDOW, META_PROP_VALUE_WINDOW, reload_net_wm_user_time_window, LOAD_INIT },
     { display->atom__NET_WM_ICON,      META_PROP_VALUE_INVALID,  reload_net_wm_icon,  NONE },
     { display->atom__KWM_WIN_ICON,     META_PROP_VALUE_INVALID,  reload_kwm_win_icon, NONE },
-    { display->atom__NET_WM_ICON_GEOMETRY, META_PROP_VALUE_CARDINAL_LIST, reload_icon_geometry, LOAD_INIT },
+    { display->atom__NET_WM_ICON_GEOMETRY, META_PROP_VALUE_CARDINAL_LIST, reload_icon_geometry, LOAD_INIT | ASYNC },
     { display->atom_WM_CLIENT_LEADER,  META_PROP_VALUE_INVALID, complain_about_broken_client, NONE },
     { display->atom_SM_CLIENT_ID,      META_PROP_VALUE_INVALID, complain_about_broken_client, NONE },
     { display->atom_WM_WINDOW_ROLE,    META_PROP_VALUE_STRING, reload_wm_window_role, LOAD_INIT | FORCE_INIT },
@@ -2364,6 +2705,7 @@ meta_display_init_window_prop_hooks (MetaDisplay *display)
 
   MetaWindowPropHooks *table = g_memdup (hooks, sizeof (hooks)),
     *cursor = table;
+  MetaPropFetchSource *fetch_source;
 
   g_assert (display->prop_hooks == NULL);
 
@@ -2378,6 +2720,9 @@ meta_display_init_window_prop_hooks (MetaDisplay *display)
       /* Forcing initialization doesn't make sense if not loading initially */
       g_assert ((cursor->flags & LOAD_INIT) || !(cursor->flags & FORCE_INIT));
 
+      /* There is nothing to fetch asynchronously for notify-only hooks */
+      g_assert (!((cursor->flags & ASYNC) && cursor->type == META_PROP_VALUE_INVALID));
+
       /* Atoms are safe to use with GINT_TO_POINTER because it's safe with
        * anything 32 bits or less, and atoms are 32 bits with the top three
        * bits clear.  (Scheifler & Gettys, 2e, p372)
@@ -2388,11 +2733,34 @@ meta_display_init_window_prop_hooks (MetaDisplay *display)
       cursor++;
     }
   display->n_prop_hooks = cursor - table;
+
+  fetch_source = (MetaPropFetchSource *)
+    g_source_new (&prop_fetch_source_funcs, sizeof (MetaPropFetchSource));
+  fetch_source->display = display;
+  g_queue_init (&fetch_source->fetches);
+  fetch_source->poll_fd.fd = ConnectionNumber (display->xdisplay);
+  fetch_source->poll_fd.events = G_IO_IN;
+  g_source_add_poll ((GSource *) fetch_source, &fetch_source->poll_fd);
+  g_source_set_name ((GSource *) fetch_source, "[mutter] property reloads");
+  g_source_attach ((GSource *) fetch_source, NULL);
+
+  display->prop_fetch_source = (GSource *) fetch_source;
 }
 
 void
 meta_display_free_window_prop_hooks (MetaDisplay *display)
 {
+  MetaPropFetchSource *fetch_source =
+    (MetaPropFetchSource *) display->prop_fetch_source;
+  MetaPropFetch *fetch;
+
+  while ((fetch = g_queue_pop_head (&fetch_source->fetches)))
+    property_fetch_free (fetch);
+
+  g_source_destroy (display->prop_fetch_source);
+  g_source_unref (display->prop_fetch_source);
+  display->prop_fetch_source = NULL;
+
   g_hash_table_unref (display->prop_hooks);
   display->prop_hooks = NULL;
 
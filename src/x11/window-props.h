@@ -49,6 +49,38 @@ void meta_window_reload_property_from_xwindow (MetaWindow      *window,
                                                Atom             property,
                                                gboolean         initial);
 
+/**
+ * meta_window_queue_property_reload:
+ * @window:     The window.
+ * @xwindow:    The X handle the property changed on.
+ * @property:   A single X atom.
+ *
+ * Like meta_window_reload_property_from_xwindow() for a property that
+ * changed after the window was set up, but properties that don't need
+ * to be current right away are fetched asynchronously, with repeated
+ * changes coalesced into one fetch.
+ */
+void meta_window_queue_property_reload (MetaWindow *window,
+                                        Window      xwindow,
+                                        Atom        property);
+
+/**
+ * meta_window_cancel_property_reloads:
+ * @window:     The window.
+ *
+ * Drops the asynchronous reloads still pending for @window.
+ */
+void meta_window_cancel_property_reloads (MetaWindow *window);
+
+/**
+ * meta_display_complete_property_reloads:
+ * @display:    The display.
+ *
+ * Runs the hooks of the pending asynchronous reloads whose replies have
+ * already been read from the X connection, without waiting for others.
+ */
+void meta_display_complete_property_reloads (MetaDisplay *display);
+
 /**
  * meta_window_load_initial_properties:
  * @window:      The window.
@@ -59,6 +91,37 @@ void meta_window_reload_property_from_xwindow (MetaWindow      *window,
  */
 void meta_window_load_initial_properties (MetaWindow *window);
 
+typedef struct _MetaWindowPropPrefetch MetaWindowPropPrefetch;
+
+/**
+ * meta_window_prefetch_initial_properties:
+ * @display:           The display.
+ * @xwindow:           The X handle of a window we are about to manage.
+ * @override_redirect: Whether the window is override-redirect.
+ *
+ * Sends the requests for the properties loaded by
+ * meta_window_load_initial_properties() without waiting for the
+ * replies, so that several windows can be fetched in one round trip.
+ * Hand the result to meta_window_load_prefetched_properties() once the
+ * window exists, or to meta_window_prefetch_free() to drop it.
+ */
+MetaWindowPropPrefetch * meta_window_prefetch_initial_properties (MetaDisplay *display,
+                                                                  Window       xwindow,
+                                                                  gboolean     override_redirect);
+
+void meta_window_prefetch_free (MetaWindowPropPrefetch *prefetch);
+
+/**
+ * meta_window_load_prefetched_properties:
+ * @window:   The window.
+ * @prefetch: (transfer full): Properties requested for @window.
+ *
+ * Like meta_window_load_initial_properties(), but consumes replies
+ * that were already requested.
+ */
+void meta_window_load_prefetched_properties (MetaWindow             *window,
+                                             MetaWindowPropPrefetch *prefetch);
+
 /**
  * meta_display_init_window_prop_hooks:
  * @display:  The display.
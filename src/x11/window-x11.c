@@ -28,6 +28,7 @@
 #include <string.h>
 #include <X11/Xatom.h>
 #include <X11/Xlibint.h> /* For display->resource_mask */
+#include <X11/Xlib-xcb.h>
 
 #include <X11/extensions/shape.h>
 
@@ -56,6 +57,27 @@ struct _MetaWindowX11Class
 
 G_DEFINE_TYPE_WITH_PRIVATE (MetaWindowX11, meta_window_x11, META_TYPE_WINDOW)
 
+/* What meta_window_x11_adopt_windows() already fetched for a window,
+ * so that managing it doesn't need any round trips of its own for
+ * attributes and initial properties.
+ */
+typedef struct
+{
+  Window                  xwindow;
+  XWindowAttributes       attrs;
+  gboolean                have_attrs;
+  uint32_t                wm_state;
+  gboolean                have_wm_state;
+  MetaWindowPropPrefetch *prefetch;
+
+  xcb_get_window_attributes_cookie_t attrs_cookie;
+  xcb_get_geometry_cookie_t          geometry_cookie;
+  xcb_get_property_cookie_t          wm_state_cookie;
+} MetaWindowX11Adoption;
+
+/* The adoption meta_window_x11_manage() should take properties from */
+static MetaWindowX11Adoption *current_adoption = NULL;
+
 static void
 meta_window_x11_init (MetaWindowX11 *window_x11)
 {
@@ -198,23 +220,77 @@ update_sm_hints (MetaWindow *window)
                 window->sm_client_id ? window->sm_client_id : "none");
 }
 
+/* The X requests a single move/resize produces for a client window
+ * (the sync request, the ConfigureWindow, _NET_FRAME_EXTENTS and the
+ * synthetic ConfigureNotify) are issued through one of these: they go
+ * straight to xcb under a single error trap, and when the client is
+ * waiting on us (an interactive resize with a sync request) the whole
+ * batch, including the frame's own requests made through GDK, goes out
+ * in one flush instead of waiting for the main loop.
+ */
+typedef struct {
+  MetaDisplay *display;
+  xcb_connection_t *xcb_conn;
+  guint n_requests;
+  gboolean needs_flush;
+} MetaX11RequestBatch;
+
 static void
-send_configure_notify (MetaWindow *window)
+request_batch_begin (MetaX11RequestBatch *batch,
+                     MetaDisplay         *display)
+{
+  batch->display = display;
+  batch->xcb_conn = XGetXCBConnection (display->xdisplay);
+  batch->n_requests = 0;
+  batch->needs_flush = FALSE;
+
+  meta_error_trap_push (display);
+}
+
+static void
+request_batch_end (MetaX11RequestBatch *batch,
+                   MetaWindow          *window)
+{
+  if (batch->needs_flush)
+    {
+      /* XFlush rather than xcb_flush, so that requests still sitting in
+       * Xlib's buffer (the frame's, which go through GDK) leave in the
+       * same write as ours.
+       */
+      XFlush (batch->display->xdisplay);
+    }
+
+  meta_error_trap_pop (batch->display);
+
+  if (batch->n_requests > 0)
+    meta_topic (META_DEBUG_GEOMETRY,
+                "Sent %u batched request(s) for %s%s\n",
+                batch->n_requests, window->desc,
+                batch->needs_flush ? " (flushed)" : "");
+}
+
+static void
+queue_configure_notify (MetaWindow          *window,
+                        MetaX11RequestBatch *batch)
 {
   MetaWindowX11 *window_x11 = META_WINDOW_X11 (window);
   MetaWindowX11Private *priv = meta_window_x11_get_instance_private (window_x11);
-  XEvent event;
+  union {
+    xcb_configure_notify_event_t configure;
+    char bytes[32];
+  } event;
+  int x, y;
 
   g_assert (!window->override_redirect);
 
   /* from twm */
 
-  event.type = ConfigureNotify;
-  event.xconfigure.display = window->display->xdisplay;
-  event.xconfigure.event = window->xwindow;
-  event.xconfigure.window = window->xwindow;
-  event.xconfigure.x = priv->client_rect.x - priv->border_width;
-  event.xconfigure.y = priv->client_rect.y - priv->border_width;
+  memset (&event, 0, sizeof (event));
+  event.configure.response_type = XCB_CONFIGURE_NOTIFY;
+  event.configure.event = window->xwindow;
+  event.configure.window = window->xwindow;
+  x = priv->client_rect.x - priv->border_width;
+  y = priv->client_rect.y - priv->border_width;
   if (window->frame)
     {
       if (window->withdrawn)
@@ -226,33 +302,42 @@ send_configure_notify (MetaWindow *window)
 
           meta_frame_calc_borders (window->frame, &borders);
 
-          event.xconfigure.x = window->frame->rect.x + borders.invisible.left;
-          event.xconfigure.y = window->frame->rect.y + borders.invisible.top;
+          x = window->frame->rect.x + borders.invisible.left;
+          y = window->frame->rect.y + borders.invisible.top;
         }
       else
         {
           /* Need to be in root window coordinates */
-          event.xconfigure.x += window->frame->rect.x;
-          event.xconfigure.y += window->frame->rect.y;
+          x += window->frame->rect.x;
+          y += window->frame->rect.y;
         }
     }
-  event.xconfigure.width = priv->client_rect.width;
-  event.xconfigure.height = priv->client_rect.height;
-  event.xconfigure.border_width = priv->border_width; /* requested not actual */
-  event.xconfigure.above = None; /* FIXME */
-  event.xconfigure.override_redirect = False;
+  event.configure.x = x;
+  event.configure.y = y;
+  event.configure.width = priv->client_rect.width;
+  event.configure.height = priv->client_rect.height;
+  event.configure.border_width = priv->border_width; /* requested not actual */
+  event.configure.above_sibling = XCB_WINDOW_NONE; /* FIXME */
+  event.configure.override_redirect = FALSE;
 
   meta_topic (META_DEBUG_GEOMETRY,
               "Sending synthetic configure notify to %s with x: %d y: %d w: %d h: %d\n",
-              window->desc,
-              event.xconfigure.x, event.xconfigure.y,
-              event.xconfigure.width, event.xconfigure.height);
+              window->desc, x, y,
+              priv->client_rect.width, priv->client_rect.height);
 
-  meta_error_trap_push (window->display);
-  XSendEvent (window->display->xdisplay,
-              window->xwindow,
-              False, StructureNotifyMask, &event);
-  meta_error_trap_pop (window->display);
+  xcb_send_event (batch->xcb_conn, FALSE, window->xwindow,
+                  XCB_EVENT_MASK_STRUCTURE_NOTIFY, event.bytes);
+  batch->n_requests++;
+}
+
+static void
+send_configure_notify (MetaWindow *window)
+{
+  MetaX11RequestBatch batch;
+
+  request_batch_begin (&batch, window->display);
+  queue_configure_notify (window, &batch);
+  request_batch_end (&batch, window);
 }
 
 static void
@@ -514,7 +599,16 @@ meta_window_x11_manage (MetaWindow *window)
   window->xgroup_leader = None;
   meta_window_compute_group (window);
 
-  meta_window_load_initial_properties (window);
+  if (current_adoption != NULL &&
+      current_adoption->xwindow == window->xwindow &&
+      current_adoption->prefetch != NULL)
+    {
+      meta_window_load_prefetched_properties (window,
+                                              current_adoption->prefetch);
+      current_adoption->prefetch = NULL;
+    }
+  else
+    meta_window_load_initial_properties (window);
 
   if (!window->override_redirect)
     update_sm_hints (window); /* must come after transient_for */
@@ -575,6 +669,7 @@ meta_window_x11_unmanage (MetaWindow *window)
 
   meta_error_trap_push (window->display);
 
+  meta_window_cancel_property_reloads (window);
   meta_window_x11_destroy_sync_request_alarm (window);
 
   if (window->withdrawn)
@@ -888,9 +983,10 @@ meta_window_x11_grab_op_ended (MetaWindow *window,
 }
 
 static void
-update_net_frame_extents (MetaWindow *window)
+update_net_frame_extents (MetaWindow          *window,
+                          MetaX11RequestBatch *batch)
 {
-  unsigned long data[4];
+  uint32_t data[4];
   MetaFrameBorders borders;
 
   meta_frame_calc_borders (window->frame, &borders);
@@ -905,15 +1001,14 @@ update_net_frame_extents (MetaWindow *window)
 
   meta_topic (META_DEBUG_GEOMETRY,
               "Setting _NET_FRAME_EXTENTS on managed window 0x%lx "
- "to left = %lu, right = %lu, top = %lu, bottom = %lu\n",
+ "to left = %u, right = %u, top = %u, bottom = %u\n",
               window->xwindow, data[0], data[1], data[2], data[3]);
 
-  meta_error_trap_push (window->display);
-  XChangeProperty (window->display->xdisplay, window->xwindow,
-                   window->display->atom__NET_FRAME_EXTENTS,
-                   XA_CARDINAL,
-                   32, PropModeReplace, (guchar*) data, 4);
-  meta_error_trap_pop (window->display);
+  xcb_change_property (batch->xcb_conn, XCB_PROP_MODE_REPLACE,
+                       window->xwindow,
+                       window->display->atom__NET_FRAME_EXTENTS,
+                       XCB_ATOM_CARDINAL, 32, 4, data);
+  batch->n_requests++;
 }
 
 static gboolean
@@ -948,9 +1043,13 @@ sync_request_timeout (gpointer data)
 }
 
 static void
-send_sync_request (MetaWindow *window)
+send_sync_request (MetaWindow          *window,
+                   MetaX11RequestBatch *batch)
 {
-  XClientMessageEvent ev;
+  union {
+    xcb_client_message_event_t message;
+    char bytes[32];
+  } ev;
   gint64 wait_serial;
 
   /* For the old style of _NET_WM_SYNC_REQUEST_COUNTER, we just have to
@@ -964,26 +1063,30 @@ send_sync_request (MetaWindow *window)
 
   window->sync_request_wait_serial = wait_serial;
 
-  ev.type = ClientMessage;
-  ev.window = window->xwindow;
-  ev.message_type = window->display->atom_WM_PROTOCOLS;
-  ev.format = 32;
-  ev.data.l[0] = window->display->atom__NET_WM_SYNC_REQUEST;
+  memset (&ev, 0, sizeof (ev));
+  ev.message.response_type = XCB_CLIENT_MESSAGE;
+  ev.message.window = window->xwindow;
+  ev.message.type = window->display->atom_WM_PROTOCOLS;
+  ev.message.format = 32;
+  ev.message.data.data32[0] = window->display->atom__NET_WM_SYNC_REQUEST;
   /* FIXME: meta_display_get_current_time() is bad, but since calls
    * come from meta_window_move_resize_internal (which in turn come
    * from all over), I'm not sure what we can do to fix it.  Do we
    * want to use _roundtrip, though?
    */
-  ev.data.l[1] = meta_display_get_current_time (window->display);
-  ev.data.l[2] = wait_serial & G_GUINT64_CONSTANT(0xffffffff);
-  ev.data.l[3] = wait_serial >> 32;
-  ev.data.l[4] = window->extended_sync_request_counter ? 1 : 0;
+  ev.message.data.data32[1] = meta_display_get_current_time (window->display);
+  ev.message.data.data32[2] = wait_serial & G_GUINT64_CONSTANT(0xffffffff);
+  ev.message.data.data32[3] = wait_serial >> 32;
+  ev.message.data.data32[4] = window->extended_sync_request_counter ? 1 : 0;
 
-  /* We don't need to trap errors here as we are already
-   * inside an error_trap_push()/pop() pair.
+  /* Errors are caught by the batch's error trap. */
+  xcb_send_event (batch->xcb_conn, FALSE, window->xwindow, 0, ev.bytes);
+  batch->n_requests++;
+
+  /* The client is about to block on our reply to its resize; don't
+   * leave the request sitting in the output buffer.
    */
-  XSendEvent (window->display->xdisplay,
-	      window->xwindow, False, 0, (XEvent*) &ev);
+  batch->needs_flush = TRUE;
 
   /* We give the window 1 sec to respond to _NET_WM_SYNC_REQUEST;
    * if this time expires, we consider the window unresponsive
@@ -1047,7 +1150,9 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
   MetaFrameBorders borders;
   MetaRectangle client_rect;
   int size_dx, size_dy;
-  XWindowChanges values;
+  MetaX11RequestBatch batch;
+  uint32_t values[5];
+  int n_values;
   unsigned int mask;
   gboolean need_configure_notify;
   gboolean need_move_client = FALSE;
@@ -1145,6 +1250,8 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
       priv->client_rect.height = client_rect.height;
     }
 
+  request_batch_begin (&batch, window->display);
+
   /* If frame extents have changed, fill in other frame fields and
      change frame's extents property. */
   if (window->frame &&
@@ -1158,7 +1265,7 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
       window->frame->right_width = borders.total.right;
       window->frame->bottom_height = borders.total.bottom;
 
-      update_net_frame_extents (window);
+      update_net_frame_extents (window, &batch);
     }
 
   /* See ICCCM 4.1.5 for when to send ConfigureNotify */
@@ -1236,24 +1343,29 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
   if (configure_frame_first && window->frame)
     frame_shape_changed = meta_frame_sync_to_window (window->frame, need_resize_frame);
 
-  values.border_width = 0;
-  values.x = client_rect.x;
-  values.y = client_rect.y;
-  values.width = client_rect.width;
-  values.height = client_rect.height;
-
+  /* XCB wants the values in the order of their mask bits */
   mask = 0;
-  if (is_configure_request && priv->border_width != 0)
-    mask |= CWBorderWidth; /* must force to 0 */
+  n_values = 0;
   if (need_move_client)
-    mask |= (CWX | CWY);
+    {
+      mask |= (XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y);
+      values[n_values++] = client_rect.x;
+      values[n_values++] = client_rect.y;
+    }
   if (need_resize_client)
-    mask |= (CWWidth | CWHeight);
+    {
+      mask |= (XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT);
+      values[n_values++] = client_rect.width;
+      values[n_values++] = client_rect.height;
+    }
+  if (is_configure_request && priv->border_width != 0)
+    {
+      mask |= XCB_CONFIG_WINDOW_BORDER_WIDTH; /* must force to 0 */
+      values[n_values++] = 0;
+    }
 
   if (mask != 0)
     {
-      meta_error_trap_push (window->display);
-
       if (window == window->display->grab_window &&
           meta_grab_op_is_resizing (window->display->grab_op) &&
           !window->disable_sync &&
@@ -1261,15 +1373,11 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
           window->sync_request_alarm != None &&
           window->sync_request_timeout_id == 0)
         {
-          send_sync_request (window);
+          send_sync_request (window, &batch);
         }
 
-      XConfigureWindow (window->display->xdisplay,
-                        window->xwindow,
-                        mask,
-                        &values);
-
-      meta_error_trap_pop (window->display);
+      xcb_configure_window (batch.xcb_conn, window->xwindow, mask, values);
+      batch.n_requests++;
     }
 
   if (!configure_frame_first && window->frame)
@@ -1281,7 +1389,9 @@ meta_window_x11_move_resize_internal (MetaWindow                *window,
     window->buffer_rect = client_rect;
 
   if (need_configure_notify)
-    send_configure_notify (window);
+    queue_configure_notify (window, &batch);
+
+  request_batch_end (&batch, window);
 
   if (priv->showing_resize_popup)
     meta_window_refresh_resize_popup (window);
@@ -2170,7 +2280,7 @@ process_property_notify (MetaWindow     *window,
         xid = window->user_time_window;
     }
 
-  meta_window_reload_property_from_xwindow (window, xid, event->atom, FALSE);
+  meta_window_queue_property_reload (window, xid, event->atom);
 
   return TRUE;
 }
@@ -3160,11 +3270,12 @@ wm_state_to_string (int state)
 }
 #endif
 
-MetaWindow *
-meta_window_x11_new (MetaDisplay       *display,
-                     Window             xwindow,
-                     gboolean           must_be_viewable,
-                     MetaCompEffect     effect)
+static MetaWindow *
+window_x11_new_internal (MetaDisplay           *display,
+                         Window                 xwindow,
+                         gboolean               must_be_viewable,
+                         MetaCompEffect         effect,
+                         MetaWindowX11Adoption *adoption)
 {
   MetaScreen *screen = display->screen;
   XWindowAttributes attrs;
@@ -3190,7 +3301,18 @@ meta_window_x11_new (MetaDisplay       *display,
    * so we must be careful with X error handling.
    */
 
-  if (!XGetWindowAttributes (display->xdisplay, xwindow, &attrs))
+  if (adoption)
+    {
+      if (!adoption->have_attrs)
+        {
+          meta_verbose ("Failed to get attributes for window 0x%lx\n",
+                        xwindow);
+          goto error;
+        }
+
+      attrs = adoption->attrs;
+    }
+  else if (!XGetWindowAttributes (display->xdisplay, xwindow, &attrs))
     {
       meta_verbose ("Failed to get attributes for window 0x%lx\n",
                     xwindow);
@@ -3222,11 +3344,19 @@ meta_window_x11_new (MetaDisplay       *display,
       uint32_t state;
 
       /* WM_STATE isn't a cardinal, it's type WM_STATE, but is an int */
-      if (!(meta_prop_get_cardinal_with_atom_type (display, xwindow,
-                                                   display->atom_WM_STATE,
-                                                   display->atom_WM_STATE,
-                                                   &state) &&
-            (state == IconicState || state == NormalState)))
+      if (adoption)
+        {
+          state = adoption->wm_state;
+          if (!adoption->have_wm_state)
+            state = WithdrawnState;
+        }
+      else if (!meta_prop_get_cardinal_with_atom_type (display, xwindow,
+                                                       display->atom_WM_STATE,
+                                                       display->atom_WM_STATE,
+                                                       &state))
+        state = WithdrawnState;
+
+      if (!(state == IconicState || state == NormalState))
         {
           meta_verbose ("Deciding not to manage unmapped or unviewable window 0x%lx\n", xwindow);
           goto error;
@@ -3297,6 +3427,7 @@ meta_window_x11_new (MetaDisplay       *display,
       goto error;
     }
 
+  current_adoption = adoption;
   window = _meta_window_shared_new (display,
                                     screen,
                                     META_WINDOW_CLIENT_TYPE_X11,
@@ -3305,6 +3436,7 @@ meta_window_x11_new (MetaDisplay       *display,
                                     existing_wm_state,
                                     effect,
                                     &attrs);
+  current_adoption = NULL;
 
   MetaWindowX11 *window_x11 = META_WINDOW_X11 (window);
   MetaWindowX11Private *priv = meta_window_x11_get_instance_private (window_x11);
@@ -3326,6 +3458,237 @@ error:
   return NULL;
 }
 
+MetaWindow *
+meta_window_x11_new (MetaDisplay       *display,
+                     Window             xwindow,
+                     gboolean           must_be_viewable,
+                     MetaCompEffect     effect)
+{
+  return window_x11_new_internal (display, xwindow, must_be_viewable,
+                                  effect, NULL);
+}
+
+/* The XGetWindowAttributes() equivalent of the two xcb replies; Xlib
+ * builds the same struct from the same two requests.
+ */
+static void
+window_attributes_from_replies (MetaDisplay                       *display,
+                                xcb_get_window_attributes_reply_t *attrs_reply,
+                                xcb_get_geometry_reply_t          *geometry_reply,
+                                XWindowAttributes                 *attrs)
+{
+  Display *xdisplay = display->xdisplay;
+  int i, d, v;
+
+  memset (attrs, 0, sizeof (*attrs));
+
+  attrs->x = geometry_reply->x;
+  attrs->y = geometry_reply->y;
+  attrs->width = geometry_reply->width;
+  attrs->height = geometry_reply->height;
+  attrs->border_width = geometry_reply->border_width;
+  attrs->depth = geometry_reply->depth;
+  attrs->root = geometry_reply->root;
+
+  attrs->class = attrs_reply->_class;
+  attrs->bit_gravity = attrs_reply->bit_gravity;
+  attrs->win_gravity = attrs_reply->win_gravity;
+  attrs->backing_store = attrs_reply->backing_store;
+  attrs->backing_planes = attrs_reply->backing_planes;
+  attrs->backing_pixel = attrs_reply->backing_pixel;
+  attrs->save_under = attrs_reply->save_under;
+  attrs->colormap = attrs_reply->colormap;
+  attrs->map_installed = attrs_reply->map_is_installed;
+  attrs->map_state = attrs_reply->map_state;
+  attrs->all_event_masks = attrs_reply->all_event_masks;
+  attrs->your_event_mask = attrs_reply->your_event_mask;
+  attrs->do_not_propagate_mask = attrs_reply->do_not_propagate_mask;
+  attrs->override_redirect = attrs_reply->override_redirect;
+
+  for (i = 0; i < ScreenCount (xdisplay); i++)
+    {
+      Screen *xscreen = ScreenOfDisplay (xdisplay, i);
+
+      if (RootWindowOfScreen (xscreen) != attrs->root)
+        continue;
+
+      attrs->screen = xscreen;
+
+      for (d = 0; d < xscreen->ndepths; d++)
+        {
+          Depth *depth = &xscreen->depths[d];
+
+          for (v = 0; v < depth->nvisuals; v++)
+            {
+              if (depth->visuals[v].visualid == attrs_reply->visual)
+                {
+                  attrs->visual = &depth->visuals[v];
+                  return;
+                }
+            }
+        }
+      return;
+    }
+}
+
+/**
+ * meta_window_x11_adopt_windows:
+ * @display: the display
+ * @xwindows: (array length=n_xwindows): windows to manage, bottom to top
+ * @n_xwindows: the number of windows
+ *
+ * Manages a batch of already existing windows, as at startup or on
+ * --replace. This is equivalent to calling meta_window_x11_new() on
+ * every window with @must_be_viewable set, except that the attributes
+ * and initial properties of all windows are requested up front, so
+ * that fetching them costs two round trips in total rather than
+ * several per window.
+ */
+void
+meta_window_x11_adopt_windows (MetaDisplay  *display,
+                               const Window *xwindows,
+                               int           n_xwindows)
+{
+  xcb_connection_t *xcb_conn = XGetXCBConnection (display->xdisplay);
+  MetaWindowX11Adoption *adoptions;
+  gint64 start_time, fetch_time;
+  int i, n_adopted;
+
+  if (n_xwindows == 0)
+    return;
+
+  start_time = g_get_monotonic_time ();
+
+  adoptions = g_new0 (MetaWindowX11Adoption, n_xwindows);
+
+  /* First pass: attributes and WM_STATE of every window */
+  for (i = 0; i < n_xwindows; i++)
+    {
+      MetaWindowX11Adoption *adoption = &adoptions[i];
+
+      adoption->xwindow = xwindows[i];
+      adoption->attrs_cookie =
+        xcb_get_window_attributes (xcb_conn, adoption->xwindow);
+      adoption->geometry_cookie =
+        xcb_get_geometry (xcb_conn, adoption->xwindow);
+      /* WM_STATE isn't a cardinal, it's type WM_STATE, but is an int */
+      adoption->wm_state_cookie =
+        xcb_get_property (xcb_conn, False, adoption->xwindow,
+                          display->atom_WM_STATE, display->atom_WM_STATE,
+                          0, 1);
+    }
+
+  for (i = 0; i < n_xwindows; i++)
+    {
+      MetaWindowX11Adoption *adoption = &adoptions[i];
+      xcb_get_window_attributes_reply_t *attrs_reply;
+      xcb_get_geometry_reply_t *geometry_reply;
+      xcb_get_property_reply_t *wm_state_reply;
+      xcb_generic_error_t *attrs_error = NULL;
+      xcb_generic_error_t *geometry_error = NULL;
+      xcb_generic_error_t *wm_state_error = NULL;
+
+      /* Errors just mean the window is already gone; collect them here
+       * so they don't end up in the event queue.
+       */
+      attrs_reply = xcb_get_window_attributes_reply (xcb_conn,
+                                                     adoption->attrs_cookie,
+                                                     &attrs_error);
+      geometry_reply = xcb_get_geometry_reply (xcb_conn,
+                                               adoption->geometry_cookie,
+                                               &geometry_error);
+      wm_state_reply = xcb_get_property_reply (xcb_conn,
+                                               adoption->wm_state_cookie,
+                                               &wm_state_error);
+      free (attrs_error);
+      free (geometry_error);
+      free (wm_state_error);
+
+      if (attrs_reply && geometry_reply)
+        {
+          window_attributes_from_replies (display, attrs_reply,
+                                          geometry_reply, &adoption->attrs);
+          adoption->have_attrs = TRUE;
+        }
+
+      if (wm_state_reply &&
+          wm_state_reply->type == display->atom_WM_STATE &&
+          wm_state_reply->format == 32 &&
+          xcb_get_property_value_length (wm_state_reply) >= 4)
+        {
+          adoption->wm_state =
+            *(uint32_t *) xcb_get_property_value (wm_state_reply);
+          adoption->have_wm_state = TRUE;
+        }
+
+      free (attrs_reply);
+      free (geometry_reply);
+      free (wm_state_reply);
+    }
+
+  /* Second pass: initial properties of everything that still exists.
+   * PropertyChangeMask is selected before the requests go out, as
+   * window_x11_new_internal() would, so that no change made between
+   * our GetProperty and managing the window is missed.
+   */
+  meta_error_trap_push (display);
+  for (i = 0; i < n_xwindows; i++)
+    {
+      MetaWindowX11Adoption *adoption = &adoptions[i];
+
+      if (!adoption->have_attrs ||
+          adoption->attrs.root != display->screen->xroot)
+        continue;
+
+      XSelectInput (display->xdisplay, adoption->xwindow,
+                    adoption->attrs.your_event_mask | PropertyChangeMask);
+
+      adoption->prefetch =
+        meta_window_prefetch_initial_properties (display,
+                                                 adoption->xwindow,
+                                                 adoption->attrs.override_redirect);
+    }
+  meta_error_trap_pop (display);
+
+  fetch_time = g_get_monotonic_time ();
+
+  /* Finally manage them, in stacking order */
+  n_adopted = 0;
+  for (i = 0; i < n_xwindows; i++)
+    {
+      MetaWindowX11Adoption *adoption = &adoptions[i];
+      MetaWindow *window;
+
+      window = window_x11_new_internal (display, adoption->xwindow, TRUE,
+                                        META_COMP_EFFECT_NONE, adoption);
+
+      if (window)
+        n_adopted++;
+
+      /* Not managed after all: drop the replies and undo our selection */
+      if (adoption->prefetch)
+        {
+          meta_window_prefetch_free (adoption->prefetch);
+
+          if (!window)
+            {
+              meta_error_trap_push (display);
+              XSelectInput (display->xdisplay, adoption->xwindow,
+                            adoption->attrs.your_event_mask);
+              meta_error_trap_pop (display);
+            }
+        }
+    }
+
+  meta_topic (META_DEBUG_STARTUP,
+              "Adopted %d of %d windows in %.1f ms (%.1f ms fetching)\n",
+              n_adopted, n_xwindows,
+              (g_get_monotonic_time () - start_time) / 1000.0,
+              (fetch_time - start_time) / 1000.0);
+
+  g_free (adoptions);
+}
+
 void
 meta_window_x11_recalc_window_type (MetaWindow *window)
 {
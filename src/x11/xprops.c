@@ -188,21 +188,11 @@ async_get_property (xcb_connection_t *xcb_conn, Window xwindow,
 }
 
 static gboolean
-async_get_property_finish (xcb_connection_t          *xcb_conn,
-                           xcb_get_property_cookie_t  cookie,
-                           GetPropertyResults        *results)
+results_from_reply (xcb_get_property_reply_t *reply,
+                    GetPropertyResults       *results)
 {
-  xcb_get_property_reply_t *reply;
-  xcb_generic_error_t *error;
   int length;
 
-  reply = xcb_get_property_reply (xcb_conn, cookie, &error);
-  if (error)
-    {
-      free (error);
-      return FALSE;
-    }
-
   results->n_items = reply->value_len;
   results->type = reply->type;
   results->bytes_after = reply->bytes_after;
@@ -224,6 +214,24 @@ async_get_property_finish (xcb_connection_t          *xcb_conn,
   return (results->prop != NULL);
 }
 
+static gboolean
+async_get_property_finish (xcb_connection_t          *xcb_conn,
+                           xcb_get_property_cookie_t  cookie,
+                           GetPropertyResults        *results)
+{
+  xcb_get_property_reply_t *reply;
+  xcb_generic_error_t *error;
+
+  reply = xcb_get_property_reply (xcb_conn, cookie, &error);
+  if (error)
+    {
+      free (error);
+      return FALSE;
+    }
+
+  return results_from_reply (reply, results);
+}
+
 static gboolean
 get_property (MetaDisplay        *display,
               Window              xwindow,
@@ -851,23 +859,48 @@ latin1_to_utf8 (const char *text)
   return g_string_free (str, FALSE);
 }
 
-void
-meta_prop_get_values (MetaDisplay   *display,
-                      Window         xwindow,
-                      MetaPropValue *values,
-                      int            n_values)
+struct _MetaPropRequest
+{
+  MetaDisplay               *display;
+  Window                     xwindow;
+  MetaPropValue             *values;
+  int                        n_values;
+  xcb_get_property_cookie_t *tasks;
+
+  /* Replies already picked up by meta_prop_poll_values(); a received
+   * task with a NULL reply got an error.
+   */
+  xcb_get_property_reply_t **replies;
+  gboolean                  *received;
+};
+
+MetaPropRequest *
+meta_prop_request_values (MetaDisplay   *display,
+                          Window         xwindow,
+                          MetaPropValue *values,
+                          int            n_values)
 {
   int i;
+  MetaPropRequest *request;
   xcb_get_property_cookie_t *tasks;
   xcb_connection_t *xcb_conn = XGetXCBConnection (display->xdisplay);
 
   meta_verbose ("Requesting %d properties of 0x%lx at once\n",
                 n_values, xwindow);
 
+  request = g_new0 (MetaPropRequest, 1);
+  request->display = display;
+  request->xwindow = xwindow;
+  request->values = values;
+  request->n_values = n_values;
+
   if (n_values == 0)
-    return;
+    return request;
 
   tasks = g_new0 (xcb_get_property_cookie_t, n_values);
+  request->tasks = tasks;
+  request->replies = g_new0 (xcb_get_property_reply_t *, n_values);
+  request->received = g_new0 (gboolean, n_values);
 
   /* Start up tasks. The "values" array can have values
    * with atom == None, which means to ignore that element.
@@ -933,10 +966,25 @@ meta_prop_get_values (MetaDisplay   *display,
       ++i;
     }
 
-  /* Get replies for all our tasks */
-  meta_topic (META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
-              n_values, G_STRFUNC);
-  XSync (display->xdisplay, False);
+  return request;
+}
+
+void
+meta_prop_finish_values (MetaPropRequest *request)
+{
+  int i;
+  MetaDisplay *display = request->display;
+  Window xwindow = request->xwindow;
+  MetaPropValue *values = request->values;
+  int n_values = request->n_values;
+  xcb_get_property_cookie_t *tasks = request->tasks;
+  xcb_connection_t *xcb_conn = XGetXCBConnection (display->xdisplay);
+
+  if (n_values == 0)
+    {
+      g_free (request);
+      return;
+    }
 
   /* Collect results, should arrive in order requested */
   i = 0;
@@ -964,7 +1012,18 @@ meta_prop_get_values (MetaDisplay   *display,
       results.bytes_after = 0;
       results.format = 0;
 
-      if (!async_get_property_finish (xcb_conn, tasks[i], &results))
+      if (request->received[i])
+        {
+          xcb_get_property_reply_t *reply = request->replies[i];
+
+          request->replies[i] = NULL;
+          if (reply == NULL || !results_from_reply (reply, &results))
+            {
+              values[i].type = META_PROP_VALUE_INVALID;
+              goto next;
+            }
+        }
+      else if (!async_get_property_finish (xcb_conn, tasks[i], &results))
         {
           values[i].type = META_PROP_VALUE_INVALID;
           goto next;
@@ -1075,6 +1134,89 @@ meta_prop_get_values (MetaDisplay   *display,
     }
 
   g_free (tasks);
+  g_free (request->replies);
+  g_free (request->received);
+  g_free (request);
+}
+
+gboolean
+meta_prop_poll_values (MetaPropRequest *request)
+{
+  int i;
+  xcb_connection_t *xcb_conn =
+    XGetXCBConnection (request->display->xdisplay);
+
+  for (i = 0; i < request->n_values; i++)
+    {
+      void *reply = NULL;
+      xcb_generic_error_t *error = NULL;
+
+      if (request->tasks[i].sequence == 0 || request->received[i])
+        continue;
+
+      if (!xcb_poll_for_reply (xcb_conn, request->tasks[i].sequence,
+                               &reply, &error))
+        return FALSE;
+
+      if (error)
+        {
+          free (error);
+          free (reply);
+          reply = NULL;
+        }
+
+      request->replies[i] = reply;
+      request->received[i] = TRUE;
+    }
+
+  return TRUE;
+}
+
+void
+meta_prop_cancel_values (MetaPropRequest *request)
+{
+  int i;
+  xcb_connection_t *xcb_conn =
+    XGetXCBConnection (request->display->xdisplay);
+
+  /* Replies we are never going to read still have to be claimed, or
+   * xcb keeps them queued on the connection forever.
+   */
+  for (i = 0; i < request->n_values; i++)
+    {
+      if (request->received[i])
+        free (request->replies[i]);
+      else if (request->tasks[i].sequence != 0)
+        xcb_discard_reply (xcb_conn, request->tasks[i].sequence);
+
+      request->values[i].type = META_PROP_VALUE_INVALID;
+    }
+
+  g_free (request->tasks);
+  g_free (request->replies);
+  g_free (request->received);
+  g_free (request);
+}
+
+void
+meta_prop_get_values (MetaDisplay   *display,
+                      Window         xwindow,
+                      MetaPropValue *values,
+                      int            n_values)
+{
+  MetaPropRequest *request;
+
+  request = meta_prop_request_values (display, xwindow, values, n_values);
+
+  if (n_values > 0)
+    {
+      /* Get replies for all our tasks */
+      meta_topic (META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
+                  n_values, G_STRFUNC);
+      XSync (display->xdisplay, False);
+    }
+
+  meta_prop_finish_values (request);
 }
 
 static void
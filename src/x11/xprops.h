@@ -199,6 +199,25 @@ void meta_prop_get_values (MetaDisplay   *display,
 void meta_prop_free_values (MetaPropValue *values,
                             int            n_values);
 
+/* Split version of meta_prop_get_values(): the request half only sends
+ * the GetProperty requests, so callers that need properties of several
+ * windows can send everything first and pay a single round trip.
+ * meta_prop_finish_values() fills in "values" (which must stay alive
+ * until then) and frees the request; meta_prop_cancel_values() drops
+ * the replies unread and marks every value INVALID.
+ * meta_prop_poll_values() never blocks: it returns TRUE once every
+ * reply has arrived, at which point finishing won't wait either.
+ */
+typedef struct _MetaPropRequest MetaPropRequest;
+
+MetaPropRequest * meta_prop_request_values (MetaDisplay   *display,
+                                            Window         xwindow,
+                                            MetaPropValue *values,
+                                            int            n_values);
+void              meta_prop_finish_values  (MetaPropRequest *request);
+gboolean          meta_prop_poll_values    (MetaPropRequest *request);
+void              meta_prop_cancel_values  (MetaPropRequest *request);
+
 #endif
 
 